@@ -0,0 +1,624 @@
+#include "AudioStream.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Samples per channel that are read from the file at once
+constexpr size_t READ_BLOCK = 4096;
+
+// Bytes that are read at once when buffering a stream
+constexpr size_t BUFFER_BLOCK = 1 << 20;
+
+// WAVE_FORMAT_* tags
+constexpr uint16_t WAVE_PCM = 0x0001;
+constexpr uint16_t WAVE_FLOAT = 0x0003;
+constexpr uint16_t WAVE_EXTENSIBLE = 0xFFFE;
+
+static uint32_t ReadInt(const uint8_t* p, unsigned int bytes, bool bigEndian)
+{
+	uint32_t value = 0;
+	for (unsigned int i = 0; i < bytes; i++)
+	{
+		unsigned int shift = bigEndian ? 8 * (bytes - 1 - i) : 8 * i;
+		value |= (uint32_t)p[i] << shift;
+	}
+	return value;
+}
+
+// 80-bit IEEE 754 extended precision, which AIFF uses for the sample rate
+static double ReadExtended(const uint8_t* p)
+{
+	int exponent = ((p[0] & 0x7F) << 8) | p[1];
+	uint64_t mantissa = 0;
+	for (int i = 0; i < 8; i++)
+		mantissa = (mantissa << 8) | p[2 + i];
+
+	if (exponent == 0 && mantissa == 0)
+		return 0.0;
+
+	double value = std::ldexp((double)mantissa, exponent - 16383 - 63);
+	return (p[0] & 0x80) ? -value : value;
+}
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+constexpr bool NATIVE_BIG_ENDIAN = true;
+#else
+constexpr bool NATIVE_BIG_ENDIAN = false;
+#endif
+
+// The sample converters below are written so that the compiler can turn the
+// decoding loops into SIMD code: the byte order is known at compile time,
+// samples are loaded with memcpy and swapped with shifts, and integers are
+// scaled by a multiplication (exact, since the factors are powers of 2)
+
+static inline uint16_t Swap(uint16_t value)
+{
+	return (uint16_t)((value >> 8) | (value << 8));
+}
+
+static inline uint32_t Swap(uint32_t value)
+{
+	return (value >> 24) | ((value >> 8) & 0xFF00) | ((value << 8) & 0xFF0000) | (value << 24);
+}
+
+static inline uint64_t Swap(uint64_t value)
+{
+	return ((uint64_t)Swap((uint32_t)value) << 32) | Swap((uint32_t)(value >> 32));
+}
+
+template<typename T, bool BigEndian>
+static inline T Load(const uint8_t* p)
+{
+	T value;
+	std::memcpy(&value, p, sizeof(value));
+	if constexpr (BigEndian != NATIVE_BIG_ENDIAN)
+		value = Swap(value);
+	return value;
+}
+
+template<SampleFormats Format>
+constexpr unsigned int BYTES_PER_SAMPLE =
+	(Format == SampleFormats::UINT8 || Format == SampleFormats::INT8) ? 1 :
+	(Format == SampleFormats::INT16) ? 2 :
+	(Format == SampleFormats::INT24) ? 3 :
+	(Format == SampleFormats::FLOAT64) ? 8 : 4;
+
+unsigned int BytesPerSample(SampleFormats format)
+{
+	switch (format)
+	{
+	case SampleFormats::UINT8: return BYTES_PER_SAMPLE<SampleFormats::UINT8>;
+	case SampleFormats::INT8: return BYTES_PER_SAMPLE<SampleFormats::INT8>;
+	case SampleFormats::INT16: return BYTES_PER_SAMPLE<SampleFormats::INT16>;
+	case SampleFormats::INT24: return BYTES_PER_SAMPLE<SampleFormats::INT24>;
+	case SampleFormats::INT32: return BYTES_PER_SAMPLE<SampleFormats::INT32>;
+	case SampleFormats::FLOAT32: return BYTES_PER_SAMPLE<SampleFormats::FLOAT32>;
+	default: return BYTES_PER_SAMPLE<SampleFormats::FLOAT64>;
+	}
+}
+
+template<SampleFormats Format, bool BigEndian>
+static inline double Decode(const uint8_t* p)
+{
+	if constexpr (Format == SampleFormats::UINT8)
+	{
+		return (double)((int)p[0] - 128) * (1.0 / 128.0);
+	}
+	else if constexpr (Format == SampleFormats::INT8)
+	{
+		return (double)(int8_t)p[0] * (1.0 / 128.0);
+	}
+	else if constexpr (Format == SampleFormats::INT16)
+	{
+		return (double)(int16_t)Load<uint16_t, BigEndian>(p) * (1.0 / 32768.0);
+	}
+	else if constexpr (Format == SampleFormats::INT24)
+	{
+		// The sample goes into the upper 3 bytes, the arithmetic shift back sign-extends it
+		uint32_t b0 = p[BigEndian ? 2 : 0], b1 = p[1], b2 = p[BigEndian ? 0 : 2];
+		int32_t value = (int32_t)((b0 << 8) | (b1 << 16) | (b2 << 24)) >> 8;
+		return (double)value * (1.0 / 8388608.0);
+	}
+	else if constexpr (Format == SampleFormats::INT32)
+	{
+		return (double)(int32_t)Load<uint32_t, BigEndian>(p) * (1.0 / 2147483648.0);
+	}
+	else if constexpr (Format == SampleFormats::FLOAT32)
+	{
+		uint32_t bits = Load<uint32_t, BigEndian>(p);
+		float value;
+		std::memcpy(&value, &bits, sizeof(value));
+		return (double)value;
+	}
+	else
+	{
+		uint64_t bits = Load<uint64_t, BigEndian>(p);
+		double value;
+		std::memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+}
+
+// De-interleaves count frames of raw file data into one array per channel.
+// Mono and stereo get their own loops with the channels unrolled, which
+// vectorize. Everything else, including a subset of the channels, goes
+// through the samples one channel at a time and never touches the others
+template<SampleFormats Format, bool BigEndian, unsigned int Channels>
+static void DecodeBlock(const uint8_t* raw, size_t count, unsigned int numChannels,
+	const unsigned int* selected, size_t numSelected, double* const* out)
+{
+	constexpr unsigned int BYTES = BYTES_PER_SAMPLE<Format>;
+
+	if constexpr (Channels == 1)
+	{
+		double* mono = out[0];
+		for (size_t i = 0; i < count; i++)
+			mono[i] = Decode<Format, BigEndian>(raw + i * BYTES);
+	}
+	else if constexpr (Channels == 2)
+	{
+		double* left = out[0];
+		double* right = out[1];
+		for (size_t i = 0; i < count; i++)
+		{
+			left[i] = Decode<Format, BigEndian>(raw + (2 * i) * BYTES);
+			right[i] = Decode<Format, BigEndian>(raw + (2 * i + 1) * BYTES);
+		}
+	}
+	else
+	{
+		const size_t blockAlign = (size_t)numChannels * BYTES;
+		for (size_t c = 0; c < numSelected; c++)
+		{
+			double* channel = out[c];
+			const uint8_t* in = raw + (size_t)selected[c] * BYTES;
+			for (size_t i = 0; i < count; i++)
+				channel[i] = Decode<Format, BigEndian>(in + i * blockAlign);
+		}
+	}
+}
+
+template<SampleFormats Format, bool BigEndian>
+static AudioStream::Decoder SelectDecoder(unsigned int numChannels)
+{
+	switch (numChannels)
+	{
+	case 1: return DecodeBlock<Format, BigEndian, 1>;
+	case 2: return DecodeBlock<Format, BigEndian, 2>;
+	default: return DecodeBlock<Format, BigEndian, 0>;
+	}
+}
+
+template<SampleFormats Format>
+static AudioStream::Decoder SelectDecoder(bool bigEndian, unsigned int numChannels)
+{
+	return bigEndian ? SelectDecoder<Format, true>(numChannels) : SelectDecoder<Format, false>(numChannels);
+}
+
+static AudioStream::Decoder SelectDecoder(SampleFormats format, bool bigEndian, unsigned int numChannels)
+{
+	switch (format)
+	{
+	case SampleFormats::UINT8: return SelectDecoder<SampleFormats::UINT8>(bigEndian, numChannels);
+	case SampleFormats::INT8: return SelectDecoder<SampleFormats::INT8>(bigEndian, numChannels);
+	case SampleFormats::INT16: return SelectDecoder<SampleFormats::INT16>(bigEndian, numChannels);
+	case SampleFormats::INT24: return SelectDecoder<SampleFormats::INT24>(bigEndian, numChannels);
+	case SampleFormats::INT32: return SelectDecoder<SampleFormats::INT32>(bigEndian, numChannels);
+	case SampleFormats::FLOAT32: return SelectDecoder<SampleFormats::FLOAT32>(bigEndian, numChannels);
+	default: return SelectDecoder<SampleFormats::FLOAT64>(bigEndian, numChannels);
+	}
+}
+
+AudioStream::AudioStream() :
+	in(nullptr), format(SampleFormats::INT16), bigEndian(false), decode(nullptr), decodeAll(nullptr),
+	sampleRate(0), numChannels(0), bytesPerSample(0),
+	numSamples(0), position(0), seekable(false), hasData(false), dataStart(0),
+	buffered(false), bufferStart(0)
+{
+}
+
+bool AudioStream::Open(std::istream& in)
+{
+	Reset(in);
+
+	uint8_t header[12];
+	if (!in.read((char*)header, sizeof(header)))
+		return Fail("file is too short");
+
+	bool ok;
+	if (std::memcmp(header, "RIFF", 4) == 0 && std::memcmp(header + 8, "WAVE", 4) == 0)
+	{
+		ok = OpenWave();
+	}
+	else if (std::memcmp(header, "FORM", 4) == 0 && (std::memcmp(header + 8, "AIFF", 4) == 0 || std::memcmp(header + 8, "AIFC", 4) == 0))
+	{
+		ok = OpenAiff(std::memcmp(header + 8, "AIFC", 4) == 0);
+	}
+	else
+	{
+		return Fail("not a WAV or AIFF file");
+	}
+
+	if (!ok)
+		return false;
+
+	return Start();
+}
+
+bool AudioStream::OpenRaw(std::istream& in, SampleFormats format, bool bigEndian, unsigned int sampleRate, unsigned int numChannels)
+{
+	Reset(in);
+
+	this->format = format;
+	this->bigEndian = bigEndian;
+	this->sampleRate = sampleRate;
+	this->numChannels = numChannels;
+	bytesPerSample = BytesPerSample(format);
+	numSamples = UNKNOWN_LENGTH;
+	StartData();
+
+	return Start();
+}
+
+void AudioStream::Reset(std::istream& in)
+{
+	this->in = &in;
+	error.clear();
+	hasData = false;
+	buffered = false;
+	std::vector<uint8_t>().swap(buffer);
+
+	// Pipes can't tell their position
+	seekable = (in.tellg() != std::streampos(-1));
+	in.clear();
+}
+
+void AudioStream::StartData()
+{
+	hasData = true;
+	if (seekable)
+		dataStart = in->tellg();
+}
+
+void AudioStream::Skip(size_t bytes)
+{
+	if (seekable)
+		in->seekg((std::streamoff)bytes, std::ios::cur);
+	else
+		in->ignore((std::streamsize)bytes);
+}
+
+bool AudioStream::Start()
+{
+	if (numChannels == 0 || sampleRate == 0)
+		return Fail("invalid header");
+
+	decodeAll = SelectDecoder(format, bigEndian, numChannels);
+	decode = decodeAll;
+	selected.resize(numChannels);
+	for (unsigned int c = 0; c < numChannels; c++)
+		selected[c] = c;
+
+	// The header may promise more samples than there are, e.g. if the
+	// recording was interrupted, or not know the length at all
+	if (seekable)
+	{
+		in->seekg(0, std::ios::end);
+		std::streamoff available = (std::streamoff)in->tellg() - dataStart;
+		numSamples = std::min(numSamples, (size_t)std::max<std::streamoff>(available, 0) / ((size_t)numChannels * bytesPerSample));
+	}
+
+	position = 0;
+	return Seek(0);
+}
+
+bool AudioStream::OpenWave()
+{
+	uint16_t audioFormat = 0;
+	unsigned int bitDepth = 0;
+	bool hasFormat = false;
+
+	uint8_t chunk[8];
+	while (in->read((char*)chunk, sizeof(chunk)))
+	{
+		uint32_t size = ReadInt(chunk + 4, 4, false);
+
+		if (std::memcmp(chunk, "fmt ", 4) == 0)
+		{
+			std::vector<uint8_t> fmt(size);
+			if (size < 16 || !in->read((char*)fmt.data(), size))
+				return Fail("invalid format chunk");
+			if (size & 1)
+				in->ignore(1);
+
+			audioFormat = (uint16_t)ReadInt(&fmt[0], 2, false);
+			numChannels = ReadInt(&fmt[2], 2, false);
+			sampleRate = ReadInt(&fmt[4], 4, false);
+			bitDepth = ReadInt(&fmt[14], 2, false);
+
+			// The actual format is the start of the sub format GUID
+			if (audioFormat == WAVE_EXTENSIBLE && size >= 26)
+				audioFormat = (uint16_t)ReadInt(&fmt[24], 2, false);
+
+			hasFormat = true;
+		}
+		else if (std::memcmp(chunk, "data", 4) == 0)
+		{
+			if (!hasFormat)
+				return Fail("data before format chunk");
+
+			StartData();
+			bytesPerSample = bitDepth / 8;
+			if (bytesPerSample == 0 || numChannels == 0)
+				return Fail("invalid format chunk");
+
+			// Streaming writers don't know the size yet and leave it at 0 or
+			// at the maximum
+			if (size == 0 || size == 0xFFFFFFFF)
+				numSamples = UNKNOWN_LENGTH;
+			else
+				numSamples = size / ((size_t)numChannels * bytesPerSample);
+			break;
+		}
+		else
+		{
+			Skip(size + (size & 1));
+		}
+	}
+
+	if (!hasData)
+		return Fail("no data chunk");
+
+	if (audioFormat == WAVE_PCM)
+	{
+		switch (bitDepth)
+		{
+		case 8: format = SampleFormats::UINT8; break;
+		case 16: format = SampleFormats::INT16; break;
+		case 24: format = SampleFormats::INT24; break;
+		case 32: format = SampleFormats::INT32; break;
+		default: return Fail("unsupported bit depth " + std::to_string(bitDepth));
+		}
+	}
+	else if (audioFormat == WAVE_FLOAT)
+	{
+		switch (bitDepth)
+		{
+		case 32: format = SampleFormats::FLOAT32; break;
+		case 64: format = SampleFormats::FLOAT64; break;
+		default: return Fail("unsupported bit depth " + std::to_string(bitDepth));
+		}
+	}
+	else
+	{
+		return Fail("unsupported encoding");
+	}
+
+	return true;
+}
+
+// AIFC files name their encoding, AIFF files are always big-endian PCM
+bool AudioStream::OpenAiff(bool compressed)
+{
+	unsigned int bitDepth = 0;
+	size_t numFrames = 0;
+	bool hasFormat = false;
+	bool littleEndian = false, isFloat = false;
+
+	uint8_t chunk[8];
+	while (in->read((char*)chunk, sizeof(chunk)))
+	{
+		uint32_t size = ReadInt(chunk + 4, 4, true);
+
+		if (std::memcmp(chunk, "COMM", 4) == 0)
+		{
+			std::vector<uint8_t> comm(size);
+			if (size < 18 || !in->read((char*)comm.data(), size))
+				return Fail("invalid COMM chunk");
+			if (size & 1)
+				in->ignore(1);
+
+			numChannels = ReadInt(&comm[0], 2, true);
+			numFrames = ReadInt(&comm[2], 4, true);
+			bitDepth = ReadInt(&comm[6], 2, true);
+			sampleRate = (unsigned int)std::lround(ReadExtended(&comm[8]));
+
+			if (compressed && size >= 22)
+			{
+				std::string type(comm.begin() + 18, comm.begin() + 22);
+				if (type == "sowt")
+					littleEndian = true;
+				else if (type == "fl32" || type == "FL32" || type == "fl64" || type == "FL64")
+					isFloat = true;
+				else if (type != "NONE" && type != "twos")
+					return Fail("unsupported compression " + type);
+			}
+
+			hasFormat = true;
+		}
+		else if (std::memcmp(chunk, "SSND", 4) == 0)
+		{
+			if (!hasFormat)
+				return Fail("sound data before COMM chunk");
+
+			uint8_t ssnd[8];
+			if (size < 8 || !in->read((char*)ssnd, sizeof(ssnd)))
+				return Fail("invalid SSND chunk");
+
+			uint32_t offset = ReadInt(ssnd, 4, true);
+			Skip(offset);
+			StartData();
+			break;
+		}
+		else
+		{
+			Skip(size + (size & 1));
+		}
+	}
+
+	if (!hasData)
+		return Fail("no sound data chunk");
+
+	bytesPerSample = (bitDepth + 7) / 8;
+	bigEndian = !littleEndian;
+	numSamples = numFrames;
+
+	if (isFloat)
+	{
+		switch (bitDepth)
+		{
+		case 32: format = SampleFormats::FLOAT32; break;
+		case 64: format = SampleFormats::FLOAT64; break;
+		default: return Fail("unsupported bit depth " + std::to_string(bitDepth));
+		}
+	}
+	else
+	{
+		switch (bitDepth)
+		{
+		case 8: format = SampleFormats::INT8; break;
+		case 16: format = SampleFormats::INT16; break;
+		case 24: format = SampleFormats::INT24; break;
+		case 32: format = SampleFormats::INT32; break;
+		default: return Fail("unsupported bit depth " + std::to_string(bitDepth));
+		}
+	}
+
+	return true;
+}
+
+bool AudioStream::Fail(const std::string& message)
+{
+	error = message;
+	return false;
+}
+
+bool AudioStream::Seek(size_t sample)
+{
+	const size_t blockAlign = (size_t)numChannels * bytesPerSample;
+
+	if (buffered)
+	{
+		if (sample < bufferStart)
+			return Fail("can't seek before the buffered samples");
+
+		position = std::min(sample, numSamples);
+		return true;
+	}
+
+	if (seekable)
+	{
+		in->clear();
+		in->seekg(dataStart + (std::streamoff)(sample * blockAlign), std::ios::beg);
+		position = sample;
+		return (bool)*in;
+	}
+
+	// Streams can only skip forward
+	if (sample < position)
+		return Fail("can't seek backwards in a stream");
+
+	raw.resize(READ_BLOCK * blockAlign);
+	while (position < sample && *in)
+	{
+		size_t n = std::min(sample - position, READ_BLOCK);
+		in->read((char*)raw.data(), n * blockAlign);
+		position += (size_t)in->gcount() / blockAlign;
+	}
+	position = sample;
+	return true;
+}
+
+bool AudioStream::Buffer(size_t count, size_t limit)
+{
+	const size_t blockAlign = (size_t)numChannels * bytesPerSample;
+	count = std::min(count, numSamples - std::min(position, numSamples));
+	size_t wanted = (count == UNKNOWN_LENGTH) ? SIZE_MAX : count * blockAlign;
+
+	buffer.clear();
+	while (buffer.size() < wanted && *in)
+	{
+		size_t size = buffer.size();
+		size_t block = std::min(wanted - size, BUFFER_BLOCK);
+		if (limit != 0 && size + block > limit)
+		{
+			if (size >= limit)
+				return Fail("the input doesn't fit into the memory limit");
+			block = limit - size;
+		}
+
+		buffer.resize(size + block);
+		in->read((char*)buffer.data() + size, block);
+		buffer.resize(size + (size_t)in->gcount());
+	}
+
+	// A partial sample at the end is dropped
+	buffer.resize(buffer.size() / blockAlign * blockAlign);
+	bufferStart = position;
+	numSamples = position + buffer.size() / blockAlign;
+	buffered = true;
+	return true;
+}
+
+void AudioStream::SelectChannels(const std::vector<unsigned int>& channels)
+{
+	selected = channels;
+
+	// The unrolled decoders only work if every channel is decoded in order
+	bool all = (selected.size() == numChannels);
+	for (size_t c = 0; c < selected.size() && all; c++)
+		all = (selected[c] == c);
+
+	decode = all ? decodeAll : SelectDecoder(format, bigEndian, 0);
+}
+
+size_t AudioStream::Read(size_t count, std::vector<std::vector<double>>& samples)
+{
+	count = std::min(count, numSamples - std::min(position, numSamples));
+
+	samples.resize(selected.size());
+	for (std::vector<double>& channel : samples)
+		channel.resize(count);
+
+	const size_t blockAlign = (size_t)numChannels * bytesPerSample;
+	if (!buffered)
+		raw.resize(std::min(count, READ_BLOCK) * blockAlign);
+	channels.resize(selected.size());
+
+	size_t done = 0;
+	while (done < count)
+	{
+		size_t n = std::min(count - done, READ_BLOCK);
+		const uint8_t* block = raw.data();
+		if (buffered)
+		{
+			block = buffer.data() + (position + done - bufferStart) * blockAlign;
+		}
+		else
+		{
+			in->read((char*)raw.data(), n * blockAlign);
+			n = (size_t)in->gcount() / blockAlign;
+		}
+		if (n == 0)
+			break;
+
+		for (size_t c = 0; c < selected.size(); c++)
+			channels[c] = samples[c].data() + done;
+		decode(block, n, numChannels, selected.data(), selected.size(), channels.data());
+
+		done += n;
+	}
+
+	// A file that ends early just gives fewer samples
+	for (std::vector<double>& channel : samples)
+		channel.resize(done);
+
+	position += done;
+	return done;
+}
+
+size_t AudioStream::Memory() const
+{
+	return READ_BLOCK * numChannels * bytesPerSample + buffer.size();
+}
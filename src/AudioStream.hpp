@@ -0,0 +1,105 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <istream>
+#include <string>
+#include <vector>
+
+// How the samples are stored in the file
+enum class SampleFormats {
+	UINT8,
+	INT8,
+	INT16,
+	INT24,
+	INT32,
+	FLOAT32,
+	FLOAT64
+};
+
+unsigned int BytesPerSample(SampleFormats format);
+
+/*
+ * Reads the samples of a WAV or AIFF file piece by piece instead of loading the
+ * whole file. Opening only parses the header, Read() then decodes the next
+ * samples of every channel. Pipes work as well, as long as nothing has to be
+ * read twice. Integer samples are divided by 2^(bits - 1), so they
+ * end up in [-1, 1).
+ */
+class AudioStream
+{
+public:
+	// Converts count frames of raw file data into one array for each of the
+	// selected channels
+	typedef void (*Decoder)(const uint8_t* raw, size_t count, unsigned int numChannels,
+		const unsigned int* selected, size_t numSelected, double* const* out);
+
+	AudioStream();
+
+	// NumSamples() of a stream that doesn't say how long it is
+	static constexpr size_t UNKNOWN_LENGTH = SIZE_MAX;
+
+	// Parses the header and moves to the first sample. Returns false and sets
+	// Error() if the file isn't a supported WAV or AIFF file
+	bool Open(std::istream& in);
+
+	// Samples without any header
+	bool OpenRaw(std::istream& in, SampleFormats format, bool bigEndian, unsigned int sampleRate, unsigned int numChannels);
+	const std::string& Error() const { return error; }
+
+	unsigned int SampleRate() const { return sampleRate; }
+	unsigned int NumChannels() const { return numChannels; }
+
+	// Samples per channel
+	size_t NumSamples() const { return numSamples; }
+
+	// Whether Seek() can go back. Pipes can only skip forward
+	bool Seekable() const { return seekable || buffered; }
+
+	// Continues reading at the given sample
+	bool Seek(size_t sample);
+
+	// Reads the next count samples (or the rest) into memory, after which
+	// Seek() can go anywhere from the current sample on and NumSamples() is
+	// known. Fails if it takes more than limit bytes (0 for no limit)
+	bool Buffer(size_t count, size_t limit);
+
+	// Channels (0-based) that Read() decodes, in the order they are returned.
+	// All channels by default. The others are skipped while de-interleaving
+	void SelectChannels(const std::vector<unsigned int>& channels);
+
+	// Decodes the next count samples of the selected channels into samples[i]
+	// for the i-th selected channel, which are resized to the number of
+	// samples read
+	size_t Read(size_t count, std::vector<std::vector<double>>& samples);
+
+	// Memory used for reading, including buffered samples but not the decoded ones
+	size_t Memory() const;
+
+private:
+	void Reset(std::istream& in);
+	bool OpenWave();
+	bool OpenAiff(bool compressed);
+	void StartData();
+	void Skip(size_t bytes);
+	bool Start();
+	bool Fail(const std::string& message);
+
+	std::istream* in;
+	std::string error;
+
+	SampleFormats format;
+	bool bigEndian;
+	Decoder decode, decodeAll;
+	unsigned int sampleRate, numChannels, bytesPerSample;
+	size_t numSamples, position;
+	bool seekable, hasData;
+	std::streamoff dataStart;
+
+	bool buffered;
+	size_t bufferStart;
+	std::vector<uint8_t> buffer;
+
+	std::vector<uint8_t> raw;
+	std::vector<unsigned int> selected;
+	std::vector<double*> channels;
+};
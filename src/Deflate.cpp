@@ -0,0 +1,205 @@
+#include "Deflate.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+// Only the parts of zlib's interface that miniz has as well are used, which is
+// why gzip's framing is written here instead of by deflateInit2()
+constexpr int LEVEL = 6;
+constexpr int WINDOW_BITS = 15;
+constexpr int MEM_LEVEL = 8;
+
+// Output is appended in pieces of this size
+constexpr size_t OUTPUT_STEP = 64 * 1024;
+
+// Input collected by DeflateStream before it is handed to the compression
+// thread, and how many chunks may wait there
+constexpr size_t CHUNK_SIZE = 256 * 1024;
+constexpr size_t MAX_QUEUED = 4;
+
+uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc)
+{
+	return (uint32_t)crc32(crc, data, (uInt)size);
+}
+
+Deflater::Deflater(Containers container) :
+	container(container), started(false), checksum(0), totalIn(0)
+{
+	stream.zalloc = Z_NULL;
+	stream.zfree = Z_NULL;
+	stream.opaque = Z_NULL;
+
+	// gzip wraps raw deflate data, zlib's own framing is the default
+	int windowBits = (container == Containers::GZIP) ? -WINDOW_BITS : WINDOW_BITS;
+	if (deflateInit2(&stream, LEVEL, Z_DEFLATED, windowBits, MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK)
+		throw std::bad_alloc();
+}
+
+Deflater::~Deflater()
+{
+	deflateEnd(&stream);
+}
+
+void Deflater::Compress(const uint8_t* data, size_t size, std::vector<uint8_t>& output, bool finish)
+{
+	if (!started && container == Containers::GZIP)
+		output.insert(output.end(), { 0x1F, 0x8B, 8, 0, 0, 0, 0, 0, 0, 0xFF });
+	started = true;
+
+	if (container == Containers::GZIP && size > 0)
+	{
+		checksum = Crc32(data, size, checksum);
+		totalIn += (uint32_t)size;
+	}
+
+	// zlib counts in 32 bit, so larger input is passed in several steps
+	const uInt maxStep = ~(uInt)0;
+	do
+	{
+		uInt step = (uInt)std::min<size_t>(size, maxStep);
+		stream.next_in = (Bytef*)data;
+		stream.avail_in = step;
+		data += step;
+		size -= step;
+
+		int flush = (finish && size == 0) ? Z_FINISH : Z_NO_FLUSH;
+		int result;
+		do
+		{
+			size_t used = output.size();
+			output.resize(used + OUTPUT_STEP);
+			stream.next_out = output.data() + used;
+			stream.avail_out = (uInt)OUTPUT_STEP;
+			result = deflate(&stream, flush);
+			output.resize(output.size() - stream.avail_out);
+		} while (stream.avail_out == 0 || (flush == Z_FINISH && result != Z_STREAM_END));
+	} while (size > 0);
+
+	if (finish && container == Containers::GZIP)
+	{
+		for (int shift = 0; shift < 32; shift += 8)
+			output.push_back((uint8_t)(checksum >> shift));
+		for (int shift = 0; shift < 32; shift += 8)
+			output.push_back((uint8_t)(totalIn >> shift));
+	}
+}
+
+size_t Deflater::Memory()
+{
+	// What zlib's documentation gives for deflateInit2(), and the output step
+	return ((size_t)1 << (WINDOW_BITS + 2)) + ((size_t)1 << (MEM_LEVEL + 9)) + OUTPUT_STEP;
+}
+
+DeflateStream::Buffer::Buffer(DeflateStream& owner) :
+	owner(owner)
+{
+}
+
+void DeflateStream::Buffer::Reset()
+{
+	setp(owner.chunk.data(), owner.chunk.data() + owner.chunk.size());
+}
+
+DeflateStream::Buffer::int_type DeflateStream::Buffer::overflow(int_type c)
+{
+	owner.Submit(pptr() - pbase());
+	Reset();
+
+	if (!traits_type::eq_int_type(c, traits_type::eof()))
+	{
+		*pptr() = traits_type::to_char_type(c);
+		pbump(1);
+	}
+
+	return traits_type::not_eof(c);
+}
+
+int DeflateStream::Buffer::sync()
+{
+	if (pptr() > pbase())
+	{
+		owner.Submit(pptr() - pbase());
+		Reset();
+	}
+
+	return 0;
+}
+
+DeflateStream::DeflateStream(std::ostream& target, Containers container) :
+	std::ostream(nullptr), target(target), deflater(container), buffer(*this),
+	chunk(CHUNK_SIZE), finished(false), closed(false)
+{
+	// buffer only exists from here on
+	rdbuf(&buffer);
+	buffer.Reset();
+	worker = std::thread(&DeflateStream::Worker, this);
+}
+
+DeflateStream::~DeflateStream()
+{
+	Close();
+}
+
+void DeflateStream::Close()
+{
+	if (closed)
+		return;
+
+	buffer.pubsync();
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		finished = true;
+	}
+	changed.notify_all();
+
+	worker.join();
+	target.flush();
+	closed = true;
+}
+
+size_t DeflateStream::Memory()
+{
+	// Queued chunks, the one being filled, the one being compressed and the
+	// compressed output
+	return (MAX_QUEUED + 3) * CHUNK_SIZE + Deflater::Memory();
+}
+
+// Hands the first size bytes of the current chunk to the compression thread,
+// waits if it is too far behind
+void DeflateStream::Submit(size_t size)
+{
+	chunk.resize(size);
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait(lock, [this]() { return chunks.size() < MAX_QUEUED; });
+		chunks.push_back(std::move(chunk));
+	}
+	changed.notify_all();
+
+	chunk.assign(CHUNK_SIZE, 0);
+}
+
+void DeflateStream::Worker()
+{
+	std::vector<uint8_t> compressed;
+	bool last = false;
+	while (!last)
+	{
+		std::vector<char> data;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			changed.wait(lock, [this]() { return !chunks.empty() || finished; });
+			if (!chunks.empty())
+			{
+				data = std::move(chunks.front());
+				chunks.pop_front();
+			}
+			last = finished && chunks.empty();
+		}
+		changed.notify_all();
+
+		compressed.clear();
+		deflater.Compress((const uint8_t*)data.data(), data.size(), compressed, last);
+		target.write((const char*)compressed.data(), compressed.size());
+	}
+}
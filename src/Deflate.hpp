@@ -0,0 +1,97 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <thread>
+#include <vector>
+
+#include <zlib.h>
+
+// Framing around the raw deflate data
+enum class Containers {
+	ZLIB,
+	GZIP
+};
+
+extern uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc = 0);
+
+/*
+ * Deflate (RFC 1951) compressor that works on a stream of chunks, done by
+ * zlib. The window carries over from one chunk to the next.
+ */
+class Deflater
+{
+public:
+	Deflater(Containers container);
+	~Deflater();
+
+	Deflater(const Deflater&) = delete;
+	Deflater& operator=(const Deflater&) = delete;
+
+	// Compresses data and appends all finished output to output. The last
+	// call has to set finish, which flushes everything and writes the trailer
+	void Compress(const uint8_t* data, size_t size, std::vector<uint8_t>& output, bool finish = false);
+
+	// Memory of the compressor state
+	static size_t Memory();
+
+private:
+	Containers container;
+	bool started;
+	uint32_t checksum;
+	uint32_t totalIn;
+
+	z_stream stream;
+};
+
+/*
+ * ostream that compresses everything written to it into another stream. The
+ * data is collected in chunks and compressed on a separate thread, so the
+ * writer doesn't have to wait for the compression. Close() (or the destructor)
+ * finishes the compressed stream.
+ */
+class DeflateStream : public std::ostream
+{
+public:
+	DeflateStream(std::ostream& target, Containers container);
+	~DeflateStream();
+
+	void Close();
+
+	// Most memory a stream holds at any time
+	static size_t Memory();
+
+private:
+	class Buffer : public std::streambuf
+	{
+	public:
+		Buffer(DeflateStream& owner);
+
+		// Points the put area at the current chunk
+		void Reset();
+
+	protected:
+		int_type overflow(int_type c) override;
+		int sync() override;
+
+	private:
+		DeflateStream& owner;
+	};
+
+	void Submit(size_t size);
+	void Worker();
+
+	std::ostream& target;
+	Deflater deflater;
+	Buffer buffer;
+	std::vector<char> chunk;
+
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::deque<std::vector<char>> chunks;
+	bool finished, closed;
+	std::thread worker;
+};
@@ -1,13 +1,43 @@
 #include "FFT.hpp"
+#include "FixedFFT.hpp"
+#include "ThreadPool.hpp"
+#include "Scratch.hpp"
 
 #define _USE_MATH_DEFINES
 #include <math.h>
+#include <algorithm>
+#include <cstring>
 #include <functional>
 #include <iostream>
 #include <map>
 
 #define POW_OF_TWO(x) (x && !(x & (x - 1)))
 
+// Transforms of at least this many points don't fit into L2 anymore and are
+// handed to the four-step engine by FFTEngines::AUTO
+constexpr size_t FOUR_STEP_THRESHOLD = (size_t)1 << 18;
+constexpr size_t TRANSPOSE_BLOCK = 16;
+
+// Split-radix transforms smaller than this are not worth splitting into tasks
+constexpr size_t PARALLEL_THRESHOLD = (size_t)1 << 15;
+
+// SlidingDFT::Faster(): a resonator update costs about this many FFT
+// operations (N log2 N per transform)
+constexpr double SLIDE_COST = 1.5;
+
+// Phasors that are rotated step by step are recomputed exactly this often
+constexpr size_t PHASOR_BLOCK = 1024;
+
+// UseDecimation(): the sample rate is lowered by a power of two to no less than
+// DECIMATION_MARGIN times the maximum frequency, and whatever would fold back
+// into the frequency range is suppressed by DECIMATION_ATTENUATION_DB. A tap of
+// the filter costs about FILTER_COST FFT operations, and transforms smaller
+// than MIN_DECIMATED_SIZE aren't worth it
+constexpr double DECIMATION_MARGIN = 3.0;
+constexpr double DECIMATION_ATTENUATION_DB = 120.0;
+constexpr double FILTER_COST = 0.5;
+constexpr size_t MIN_DECIMATED_SIZE = 64;
+
 constexpr double REC_2_FAC = (double)1.0f / (double)2.0f;
 constexpr double REC_3_FAC = (double)1.0f / (double)6.0f;
 constexpr double REC_4_FAC = (double)1.0f / (double)24.0f;
@@ -19,11 +49,34 @@ constexpr double REC_9_FAC = (double)1.0f / (double)362880.0f;
 
 using namespace std::complex_literals;
 
-typedef std::function<double(unsigned int)> WindowFunction;
+typedef std::function<double(unsigned int, unsigned int)> WindowFunction;
 typedef std::function<double(double)> TrigFunction;
 typedef std::function<std::complex<double>(double)> ExpFunction;
 
+// The engines work on split complex data: real and imaginary parts live in
+// separate arrays, so the butterflies vectorize without any shuffling
+struct Twiddles
+{
+	const double* re;
+	const double* im;
+};
+
+// Buffers that the transforms of a plan reuse (see Scratch)
+struct Workspace
+{
+	std::vector<double> signal;
+	std::vector<double> re, im;
+	std::vector<double> workRe, workIm;
+	std::vector<double> decimated;
+};
+
 WindowFunction window;
+WindowFunctions windowType = WindowFunctions::RECTANGLE;
+bool fastFunctions = false;
+bool decimate = false;
+FFTEngines engine = FFTEngines::AUTO;
+Scales scale = Scales::LINEAR;
+double dbFloor = -120.0;
 TrigFunction Sin = std::bind((double(*)(double))& std::sin, std::placeholders::_1);
 TrigFunction Cos = std::bind((double(*)(double))& std::cos, std::placeholders::_1);
 
@@ -35,103 +88,862 @@ inline double WindowBlackman(unsigned int k, unsigned int offset, unsigned int w
 
 double FastCos(double x);
 double FastSin(double x);
+inline double FastLog10(double x);
+double BesselI0(double x);
+size_t FilterHalfLength(size_t sampleRate, size_t decimation, double maxFreq);
+inline void ScaleBins(const double* re, const double* im, size_t numBins, double factor, Scales scale, double floor, double* output);
 std::complex<double> ComplexExp(double x);
 
-std::vector<std::complex<double>> 
+// Radix-2 decimation in time. The two halves are transformed into their
+// final place in re/im, so the butterflies can work in-place
+void
 radix2dit(
 	const std::vector<double>& list,
 	size_t offset,
 	size_t N, 
-	size_t s)
+	size_t s,
+	double* re, double* im)
 {
-	std::vector<std::complex<double>> output(N);
 	if (N == 1)
 	{
-		output[0] = window(offset) * (list[offset]);
+		re[0] = list[offset];
+		im[0] = 0.0;
 	}
 	else
 	{
 		size_t halfN = N >> 1;
-		std::vector<std::complex<double>> first = radix2dit(list, offset, halfN, s << 1);
-		std::vector<std::complex<double>> second = radix2dit(list, offset + s, halfN, s << 1);
+		radix2dit(list, offset, halfN, s << 1, re, im);
+		radix2dit(list, offset + s, halfN, s << 1, re + halfN, im + halfN);
 
 		double coeff = -M_PI / (double)halfN;
 
 		for (int k = 0; k < halfN; k++)
 		{
-			std::complex<double> p = first[k];
-			std::complex<double> q = ComplexExp(coeff * (double)k) * second[k];
+			std::complex<double> w = ComplexExp(coeff * (double)k);
+			double qr = w.real() * re[halfN + k] - w.imag() * im[halfN + k];
+			double qi = w.real() * im[halfN + k] + w.imag() * re[halfN + k];
 
-			output[k] = p + q;
-			output[halfN + k] = p - q;
+			re[halfN + k] = re[k] - qr;
+			im[halfN + k] = im[k] - qi;
+			re[k] += qr;
+			im[k] += qi;
 		}
 	}
+}
 
-	return output;
+// Calls func(begin, end) on chunks of [0, count), as tasks on the thread pool
+void
+ParallelFor(size_t count, const std::function<void(size_t, size_t)>& func)
+{
+	ThreadPool& pool = GetThreadPool();
+
+	// A few chunks per thread so that stealing can even out the load
+	size_t chunks = std::min<size_t>((size_t)pool.Size() * 4, count);
+	if (pool.Size() == 1 || chunks <= 1)
+	{
+		func(0, count);
+		return;
+	}
+
+	TaskGroup group(pool);
+	for (size_t c = 1; c < chunks; c++)
+		group.Run([&func, count, chunks, c]() { func(count * c / chunks, count * (c + 1) / chunks); });
+
+	func(0, count / chunks);
+	group.Wait();
 }
 
-std::vector<std::pair<double, double>>
-FFT(const std::vector<double>::const_iterator& begin,
-	const std::vector<double>::const_iterator& end,
-	size_t sampleRate,
-	double minFreq, double maxFreq,
-	unsigned int zeropadding)
+// The L-butterflies of one split-radix level for k in [begin, end). re/im
+// hold the transform of the even samples in [0, N/2) and those of the two
+// odd quarters in [N/2, 3N/4) and [3N/4, N)
+void
+combine(
+	double* re, double* im,
+	size_t N,
+	const Twiddles& twiddles,
+	size_t tstride,
+	size_t begin, size_t end)
+{
+	size_t halfN = N >> 1;
+	size_t quarterN = N >> 2;
+	const double* wRe = twiddles.re;
+	const double* wIm = twiddles.im;
+
+	for (size_t k = begin; k < end; k++)
+	{
+		const size_t w1 = k * tstride;
+		const size_t w3 = 3 * w1;
+		const size_t z1 = halfN + k;
+		const size_t z3 = halfN + quarterN + k;
+
+		double ar = wRe[w1] * re[z1] - wIm[w1] * im[z1];
+		double ai = wRe[w1] * im[z1] + wIm[w1] * re[z1];
+		double br = wRe[w3] * re[z3] - wIm[w3] * im[z3];
+		double bi = wRe[w3] * im[z3] + wIm[w3] * re[z3];
+
+		double sr = ar + br, si = ai + bi;
+		double dr = ar - br, di = ai - bi;
+
+		const size_t u1 = k + quarterN;
+		const double u0r = re[k], u0i = im[k];
+		const double u1r = re[u1], u1i = im[u1];
+
+		re[k] = u0r + sr;				im[k] = u0i + si;
+		re[z1] = u0r - sr;				im[z1] = u0i - si;
+		re[u1] = u1r + di;				im[u1] = u1i - dr;
+		re[z3] = u1r - di;				im[z3] = u1i + dr;
+	}
+}
+
+// Split-radix decimation in time. Transforms the samples inRe/inIm[0],
+// inRe/inIm[stride], ... into re/im[0..N). inIm is only read for complex
+// input. The even half and the two odd quarters are transformed into their
+// final place, so the combining L-butterflies can work in-place. twiddles
+// holds exp(-2*pi*i*j/M) for the top level size M, tstride maps the current
+// size onto that table
+template<bool ComplexInput>
+void
+splitradix(
+	const double* inRe, const double* inIm,
+	size_t stride,
+	double* re, double* im,
+	size_t N,
+	const Twiddles& twiddles,
+	size_t tstride)
+{
+	if (N == 1)
+	{
+		re[0] = inRe[0];
+		im[0] = ComplexInput ? inIm[0] : 0.0;
+		return;
+	}
+
+	if (N == 2)
+	{
+		re[0] = inRe[0] + inRe[stride];
+		re[1] = inRe[0] - inRe[stride];
+		im[0] = ComplexInput ? inIm[0] + inIm[stride] : 0.0;
+		im[1] = ComplexInput ? inIm[0] - inIm[stride] : 0.0;
+		return;
+	}
+
+	size_t halfN = N >> 1;
+	size_t quarterN = N >> 2;
+	size_t odd3 = 3 * stride;
+	splitradix<ComplexInput>(inRe, inIm, stride << 1, re, im, halfN, twiddles, tstride << 1);
+	splitradix<ComplexInput>(inRe + stride, inIm + (ComplexInput ? stride : 0), stride << 2,
+		re + halfN, im + halfN, quarterN, twiddles, tstride << 2);
+	splitradix<ComplexInput>(inRe + odd3, inIm + (ComplexInput ? odd3 : 0), stride << 2,
+		re + halfN + quarterN, im + halfN + quarterN, quarterN, twiddles, tstride << 2);
+
+	combine(re, im, N, twiddles, tstride, 0, quarterN);
+}
+
+// Same as splitradix, but the top levels of the recursion run as tasks on the
+// thread pool. Below PARALLEL_THRESHOLD points the serial kernel takes over
+void
+splitradixParallel(
+	const double* input,
+	size_t stride,
+	double* re, double* im,
+	size_t N,
+	const Twiddles& twiddles,
+	size_t tstride)
+{
+	ThreadPool& pool = GetThreadPool();
+	if (N < PARALLEL_THRESHOLD || pool.Size() == 1)
+	{
+		splitradix<false>(input, nullptr, stride, re, im, N, twiddles, tstride);
+		return;
+	}
+
+	size_t halfN = N >> 1;
+	size_t quarterN = N >> 2;
+
+	TaskGroup group(pool);
+	group.Run([=, &twiddles]() { splitradixParallel(input, stride << 1, re, im, halfN, twiddles, tstride << 1); });
+	group.Run([=, &twiddles]() { splitradixParallel(input + stride, stride << 2, re + halfN, im + halfN, quarterN, twiddles, tstride << 2); });
+	splitradixParallel(input + 3 * stride, stride << 2, re + halfN + quarterN, im + halfN + quarterN, quarterN, twiddles, tstride << 2);
+	group.Wait();
+
+	ParallelFor(quarterN, [=, &twiddles](size_t begin, size_t end)
+	{
+		combine(re, im, N, twiddles, tstride, begin, end);
+	});
+}
+
+// exp(-2*pi*i*j/N) for j < count
+void
+FillTwiddles(std::vector<double>& re, std::vector<double>& im, size_t N, size_t count)
+{
+	re.resize(count);
+	im.resize(count);
+
+	double coeff = -2.0 * M_PI / (double)N;
+	for (size_t j = 0; j < count; j++)
+	{
+		std::complex<double> w = ComplexExp(coeff * (double)j);
+		re[j] = w.real();
+		im[j] = w.imag();
+	}
+}
+
+// twiddles has to hold the first 3N/4 factors for N
+void
+SplitRadixFFT(const std::vector<double>& signal, double* re, double* im, const Twiddles& twiddles)
+{
+	splitradixParallel(signal.data(), 1, re, im, signal.size(), twiddles, 1);
+}
+
+// out = in^T for a rows x cols matrix, tile by tile so that both the reads
+// and the writes stay within a few cache lines
+void
+Transpose(const double* in, double* out, size_t rows, size_t cols)
+{
+	ParallelFor((rows + TRANSPOSE_BLOCK - 1) / TRANSPOSE_BLOCK, [&](size_t begin, size_t end)
+	{
+		for (size_t rb = begin * TRANSPOSE_BLOCK; rb < std::min(rows, end * TRANSPOSE_BLOCK); rb += TRANSPOSE_BLOCK)
+		{
+			for (size_t cb = 0; cb < cols; cb += TRANSPOSE_BLOCK)
+			{
+				size_t rEnd = std::min(rb + TRANSPOSE_BLOCK, rows);
+				size_t cEnd = std::min(cb + TRANSPOSE_BLOCK, cols);
+				for (size_t r = rb; r < rEnd; r++)
+					for (size_t c = cb; c < cEnd; c++)
+						out[c * rows + r] = in[r * cols + c];
+			}
+		}
+	});
+}
+
+// Length-len FFTs of every row of a rows x len matrix, from in to out.
+// inIm == nullptr means the rows are real
+void
+RowFFTs(const double* inRe, const double* inIm, double* re, double* im, size_t rows, size_t len,
+	const Twiddles& twiddles, size_t tstride)
+{
+	ParallelFor(rows, [&](size_t begin, size_t end)
+	{
+		for (size_t r = begin; r < end; r++)
+		{
+			if (inIm)
+				splitradix<true>(inRe + r * len, inIm + r * len, 1, re + r * len, im + r * len, len, twiddles, tstride);
+			else
+				splitradix<false>(inRe + r * len, nullptr, 1, re + r * len, im + r * len, len, twiddles, tstride);
+		}
+	});
+}
+
+// Four-step (Bailey) FFT for transforms that are larger than the caches.
+// N is split into N1 x N2 with N1 ~ sqrt(N), so that every sub-transform and
+// every tile of the transposes fits into cache
+size_t
+FourStepRows(size_t N)
+{
+	size_t log2N = 0;
+	while (((size_t)1 << log2N) < N)
+		log2N++;
+
+	return (size_t)1 << (log2N / 2);
+}
+
+// rowTwiddles holds 3/4 of the factors for N2, high exp(-2*pi*i*a*N1/N) for
+// a < N2 and low exp(-2*pi*i*b/N) for b < N1
+void
+FourStepFFT(const std::vector<double>& signal, double* re, double* im,
+	const Twiddles& rowTwiddles, const Twiddles& high, const Twiddles& low, Workspace& workspace)
 {
-	std::vector<double> signal(begin, end);
 	size_t N = signal.size();
+	size_t N1 = FourStepRows(N);
+	size_t N2 = N / N1;
+
+	workspace.workRe.resize(N);
+	workspace.workIm.resize(N);
+	double* workRe = workspace.workRe.data();
+	double* workIm = workspace.workIm.data();
+
+	// 1. Columns of the N1 x N2 input become rows, then N2 real transforms of length N1
+	Transpose(signal.data(), re, N1, N2);
+	RowFFTs(re, nullptr, workRe, workIm, N2, N1, rowTwiddles, N2 / N1);
+
+	// 2. Twiddle by exp(-2*pi*i*n2*k1/N), split into two small tables
+	ParallelFor(N2, [&](size_t begin, size_t end)
+	{
+		for (size_t n2 = begin; n2 < end; n2++)
+		{
+			double* rowRe = workRe + n2 * N1;
+			double* rowIm = workIm + n2 * N1;
+			for (size_t k1 = 0; k1 < N1; k1++)
+			{
+				size_t j = (n2 * k1) & (N - 1);
+				size_t h = j / N1;
+				size_t l = j & (N1 - 1);
+
+				double wr = high.re[h] * low.re[l] - high.im[h] * low.im[l];
+				double wi = high.re[h] * low.im[l] + high.im[h] * low.re[l];
+				double xr = rowRe[k1], xi = rowIm[k1];
+				rowRe[k1] = xr * wr - xi * wi;
+				rowIm[k1] = xr * wi + xi * wr;
+			}
+		}
+	});
+
+	// 3. N1 transforms of length N2
+	Transpose(workRe, re, N2, N1);
+	Transpose(workIm, im, N2, N1);
+	RowFFTs(re, im, workRe, workIm, N1, N2, rowTwiddles, 1);
+
+	// 4. X[k1 + N1 * k2] sits in row k1, column k2
+	Transpose(workRe, re, N1, N2);
+	Transpose(workIm, im, N1, N2);
+}
+
+// Bit-reversal table of the compile-time specialized kernel for N, or
+// nullptr if N isn't one of the common frame sizes
+const uint16_t*
+FixedSizeReverse(size_t N)
+{
+	switch (N)
+	{
+	case 256:	return FixedFFT::Reverse<256>();
+	case 512:	return FixedFFT::Reverse<512>();
+	case 1024:	return FixedFFT::Reverse<1024>();
+	case 2048:	return FixedFFT::Reverse<2048>();
+	case 4096:	return FixedFFT::Reverse<4096>();
+	default: return nullptr;
+	}
+}
+
+void
+FixedSizeFFT(size_t N, double* re, double* im)
+{
+	switch (N)
+	{
+	case 256:	FixedFFT::Transform<256>(re, im); break;
+	case 512:	FixedFFT::Transform<512>(re, im); break;
+	case 1024:	FixedFFT::Transform<1024>(re, im); break;
+	case 2048:	FixedFFT::Transform<2048>(re, im); break;
+	case 4096:	FixedFFT::Transform<4096>(re, im); break;
+	}
+}
+
+size_t FFTPlan::PaddedSize(size_t frameSize, unsigned int zeropadding)
+{
+	size_t N = frameSize;
 	while (!POW_OF_TWO(N))
 	{
 		// Pad with zeros
-		signal.push_back(0.0f);
 		N++;
 	}
 
-	if (zeropadding > 1) {
-		N = (signal.size() << (zeropadding - 1));
-		signal.insert(signal.end(), N - signal.size(), 0);
+	if (zeropadding > 1)
+		N <<= (zeropadding - 1);
+
+	return N;
+}
+
+FFTPlan::FFTPlan(size_t frameSize, unsigned int windowWidth, size_t sampleRate,
+	double minFreq, double maxFreq, unsigned int zeropadding,
+	const std::vector<double>& targets) :
+	frameSize(frameSize), N(PaddedSize(frameSize, zeropadding)), decimation(1)
+{
+
+	// Frames are usually exactly windowWidth samples long, so the last one
+	// is the only one that needs a second plan
+	window.resize(std::max<size_t>(windowWidth, frameSize));
+	for (size_t k = 0; k < window.size(); k++)
+		window[k] = ::window(k, windowWidth);
+
+	// reverse is only set if one of the compile-time specialized kernels is used
+	outputScale = scale;
+	floor = dbFloor;
+
+	engineType = engine;
+	reverse = nullptr;
+	if (!targets.empty())
+	{
+		// The coefficients are exact even with UseFastFunctions(), the
+		// recursion would drift far off the frequency otherwise
+		frequencies = targets;
+		firstBin = 0;
+		for (double freq : targets)
+		{
+			double w = 2.0 * M_PI * freq / (double)sampleRate;
+			targetCoeff.push_back(2.0 * std::cos(w));
+			targetCos.push_back(std::cos(w));
+			targetSin.push_back(std::sin(w));
+		}
+		return;
+	}
+
+	// N * decimation points at sampleRate are as far apart as N points at
+	// sampleRate / decimation, so the bins don't move. Of the factors that
+	// are possible, the one with the least estimated work is used, if any
+	const size_t fullSize = N;
+	if (decimate && maxFreq > 0)
+	{
+		double best = (double)N * std::log2((double)N);
+		for (size_t factor = 2; (double)sampleRate >= (double)factor * DECIMATION_MARGIN * maxFreq && N / factor >= MIN_DECIMATED_SIZE; factor *= 2)
+		{
+			size_t half = FilterHalfLength(sampleRate, factor, maxFreq);
+			double outputs = (double)((frameSize + 2 * half) / factor);
+			double cost = (double)(N / factor) * std::log2((double)(N / factor)) + FILTER_COST * outputs * (double)(2 * half + 1);
+			if (cost < best)
+			{
+				best = cost;
+				decimation = factor;
+			}
+		}
+	}
+	if (decimation > 1)
+	{
+		N /= decimation;
+
+		// Kaiser windowed sinc with its cutoff at the new Nyquist frequency
+		double beta = 0.1102 * (DECIMATION_ATTENUATION_DB - 8.7);
+		ptrdiff_t half = (ptrdiff_t)FilterHalfLength(sampleRate, decimation, maxFreq);
+		double sum = 0.0;
+		for (ptrdiff_t t = -half; t <= half; t++)
+		{
+			double x = M_PI * (double)t / (double)decimation;
+			double r = (double)t / (double)half;
+			double tap = (t == 0 ? 1.0 : std::sin(x) / x) * BesselI0(beta * std::sqrt(1.0 - r * r)) / BesselI0(beta);
+			taps.push_back(tap);
+			sum += tap;
+		}
+		for (double& tap : taps)
+			tap /= sum;
+
+		unitWindow.assign(N, 1.0);
+	}
+
+	if (engineType == FFTEngines::AUTO)
+	{
+		reverse = FixedSizeReverse(N);
+		if (!reverse)
+			engineType = (N >= FOUR_STEP_THRESHOLD) ? FFTEngines::FOUR_STEP : FFTEngines::SPLIT_RADIX;
 	}
 
-	WindowFunction f;
-	
-	
+	if (engineType == FFTEngines::SPLIT_RADIX)
+	{
+		// w^3k reaches up to 3N/4
+		FillTwiddles(twiddleRe, twiddleIm, N, N - N / 4);
+	}
+	else if (engineType == FFTEngines::FOUR_STEP)
+	{
+		// N1 is either N2 or N2 / 2, so the table for N2 covers both row sizes
+		size_t N1 = FourStepRows(N);
+		size_t N2 = N / N1;
+		FillTwiddles(twiddleRe, twiddleIm, N2, N2 - N2 / 4);
+		FillTwiddles(highRe, highIm, N2, N2);
+		FillTwiddles(lowRe, lowIm, N, N1);
+	}
 
-	std::vector<std::complex<double>> spectrum = radix2dit(signal, 0, N, 1);
-	double freqRes = (double)sampleRate / (double)N;
+	double freqRes = (double)sampleRate / (double)fullSize;
 	double nyquistLimit = (double)sampleRate / 2.0f;
 
-	std::vector<std::pair<double, double>> output;
 	double freq = minFreq;
 	if (maxFreq == 0)
 		maxFreq = nyquistLimit;
 
-	for (int k = freq / freqRes; freq < nyquistLimit && freq < maxFreq; k++)
+	firstBin = (size_t)(freq / freqRes);
+	for (; freq < nyquistLimit && freq < maxFreq; freq += freqRes)
+		frequencies.push_back(freq);
+}
+
+// Workspace is only complete here
+FFTPlan::~FFTPlan() = default;
+
+size_t FFTPlan::Memory(size_t frameSize, unsigned int windowWidth, unsigned int zeropadding)
+{
+	// Window, up to 3N/4 complex twiddles (less for four-step) and at most
+	// N/2 frequencies. Decimation at least halves the twiddles, which leaves
+	// more room than its filter takes
+	size_t N = PaddedSize(frameSize, zeropadding);
+	return (std::max<size_t>(windowWidth, frameSize) + 2 * N) * sizeof(double);
+}
+
+size_t FFTPlan::WorkspaceMemory(size_t frameSize, unsigned int zeropadding)
+{
+	// re/im, and signal/workRe/workIm for four-step. Decimation at least
+	// halves all of them and adds a buffer of the decimated size
+	return 5 * PaddedSize(frameSize, zeropadding) * sizeof(double);
+}
+
+void
+FFTPlan::Execute(const double* samples, size_t n, double* output) const
+{
+	Scratch<Workspace> workspace(workspaces);
+	const double* win = window.data();
+	if (!targetCoeff.empty())
+	{
+		ExecuteGoertzel(samples, n, output, *workspace);
+		return;
+	}
+
+	if (decimation > 1)
+	{
+		Decimate(samples, n, *workspace);
+		samples = workspace->decimated.data();
+		n = N;
+		win = unitWindow.data();
+	}
+
+	workspace->re.resize(N);
+	workspace->im.resize(N);
+	double* re = workspace->re.data();
+	double* im = workspace->im.data();
+
+	// Input stage: window, zero-pad and store in the engine's input order in
+	// a single pass
+	if (reverse)
+	{
+		for (size_t k = 0; k < n; k++)
+			re[reverse[k]] = samples[k] * win[k];
+		for (size_t k = n; k < N; k++)
+			re[reverse[k]] = 0.0;
+		std::fill(im, im + N, 0.0);
+
+		FixedSizeFFT(N, re, im);
+	}
+	else
+	{
+		std::vector<double>& signal = workspace->signal;
+		signal.resize(N);
+		for (size_t k = 0; k < n; k++)
+			signal[k] = samples[k] * win[k];
+		std::fill(signal.begin() + n, signal.end(), 0.0);
+
+		Twiddles twiddles = { twiddleRe.data(), twiddleIm.data() };
+		switch (engineType)
+		{
+		case FFTEngines::RADIX2:		radix2dit(signal, 0, N, 1, re, im); break;
+		case FFTEngines::SPLIT_RADIX:	SplitRadixFFT(signal, re, im, twiddles); break;
+		case FFTEngines::FOUR_STEP:
+			FourStepFFT(signal, re, im, twiddles,
+				{ highRe.data(), highIm.data() }, { lowRe.data(), lowIm.data() }, *workspace);
+			break;
+		default: break;
+		}
+	}
+
+	// Output stage: only the bins in the frequency range, straight into the
+	// output
+	ScaleBins(re + firstBin, im + firstBin, frequencies.size(), 2.0 / (double)N, outputScale, floor, output);
+}
+
+void
+FFTPlan::ExecuteGoertzel(const double* samples, size_t n, double* output, Workspace& workspace) const
+{
+	// s[n] = x[n] + 2 cos(w) s[n - 1] - s[n - 2] for all targets at once. The
+	// inner loop runs over the targets, which are independent of each other,
+	// so it is vectorized
+	const size_t numTargets = frequencies.size();
+	workspace.re.assign(numTargets, 0.0);
+	workspace.im.assign(numTargets, 0.0);
+	double* s1 = workspace.re.data();
+	double* s2 = workspace.im.data();
+	const double* coeff = targetCoeff.data();
+	const double* win = window.data();
+	for (size_t k = 0; k < n; k++)
+	{
+		double x = samples[k] * win[k];
+		for (size_t i = 0; i < numTargets; i++)
+		{
+			double s0 = x + coeff[i] * s1[i] - s2[i];
+			s2[i] = s1[i];
+			s1[i] = s0;
+		}
+	}
+
+	// X = s[n - 1] - e^-iw s[n - 2], up to a phase that doesn't change the
+	// magnitude
+	for (size_t i = 0; i < numTargets; i++)
+	{
+		double re = s1[i] - targetCos[i] * s2[i];
+		double im = targetSin[i] * s2[i];
+		s1[i] = re;
+		s2[i] = im;
+	}
+
+	ScaleBins(s1, s2, numTargets, 2.0 / (double)N, outputScale, floor, output);
+}
+
+void
+FFTPlan::Decimate(const double* samples, size_t n, Workspace& workspace) const
+{
+	// The frame is windowed before it is filtered, and the filter's tails
+	// before and after the frame are kept. The bins in the range are then
+	// those of the full transform, whatever the window does at the edges.
+	// Tails that stick out of the transform wrap around, the transform is
+	// circular anyway
+	std::vector<double>& windowed = workspace.signal;
+	windowed.resize(n);
+	for (size_t k = 0; k < n; k++)
+		windowed[k] = samples[k] * window[k];
+
+	std::vector<double>& output = workspace.decimated;
+	output.assign(N, 0.0);
+
+	// Polyphase form: only the samples that are kept are filtered
+	const ptrdiff_t half = (ptrdiff_t)(taps.size() / 2);
+	const ptrdiff_t step = (ptrdiff_t)decimation;
+	const ptrdiff_t size = (ptrdiff_t)N;
+	for (ptrdiff_t j = -(half / step); j * step < (ptrdiff_t)n + half; j++)
+	{
+		ptrdiff_t center = j * step;
+		ptrdiff_t first = std::max<ptrdiff_t>(center - half, 0);
+		ptrdiff_t last = std::min<ptrdiff_t>(center + half + 1, (ptrdiff_t)n);
+		const double* h = taps.data() + (first - center + half);
+		const double* x = windowed.data() + first;
+
+		// Four partial sums, so the loop isn't bound by the latency of one
+		ptrdiff_t count = last - first;
+		double sums[4] = { 0.0, 0.0, 0.0, 0.0 };
+		ptrdiff_t k = 0;
+		for (; k + 4 <= count; k += 4)
+		{
+			sums[0] += h[k] * x[k];
+			sums[1] += h[k + 1] * x[k + 1];
+			sums[2] += h[k + 2] * x[k + 2];
+			sums[3] += h[k + 3] * x[k + 3];
+		}
+		for (; k < count; k++)
+			sums[0] += h[k] * x[k];
+		output[((j % size) + size) % size] += (sums[0] + sums[1]) + (sums[2] + sums[3]);
+	}
+}
+
+SlidingDFT::SlidingDFT(const FFTPlan& plan) :
+	plan(plan), slid(0), valid(false)
+{
+	// w[m] = a0 + a1 cos(2 pi m / P) + a2 cos(4 pi m / P) for offset <= m < frameSize,
+	// with the same constants as the window functions. Since
+	// cos(x) = (e^ix + e^-ix) / 2, a windowed bin at w is the sum of
+	// unwindowed ones at w - 2 pi j / P ... w + 2 pi j / P
+	switch (windowType)
+	{
+	case WindowFunctions::VON_HANN:	coefficients = { -0.25, 0.5, -0.25 }; offset = 1; break;
+	case WindowFunctions::BLACKMAN:
+	{
+		double a0 = (double)0.5f * ((double)1.0f - (double)0.16f);
+		double a2 = (double)0.5f * (double)0.16f;
+		coefficients = { a2 / 2.0, -0.25, a0, -0.25, a2 / 2.0 };
+		offset = 0;
+		break;
+	}
+	default:	coefficients = { 1.0 }; offset = 1; break;
+	}
+	perBin = coefficients.size();
+	period = plan.frameSize - 1;
+
+	size_t count = plan.NumBins() * perBin;
+	rotateRe.resize(count);
+	rotateIm.resize(count);
+	firstRe.resize(count);
+	firstIm.resize(count);
+	nextRe.resize(count);
+	nextIm.resize(count);
+	sumRe.resize(count);
+	sumIm.resize(count);
+	binRe.resize(plan.NumBins());
+	binIm.resize(plan.NumBins());
+
+	// One slide: S' = e^iw (S - x[t + offset] e^-iw*offset + x[t + frameSize] e^-iw*frameSize)
+	for (size_t r = 0; r < count; r++)
+	{
+		std::complex<double> rotate = std::polar(1.0, Phase(r, 1));
+		std::complex<double> first = std::polar(1.0, -Phase(r, offset));
+		std::complex<double> next = std::polar(1.0, -Phase(r, plan.frameSize));
+		rotateRe[r] = rotate.real();
+		rotateIm[r] = rotate.imag();
+		firstRe[r] = first.real();
+		firstIm[r] = first.imag();
+		nextRe[r] = next.real();
+		nextIm[r] = next.imag();
+	}
+}
+
+bool SlidingDFT::Faster(const FFTPlan& plan, size_t hop)
+{
+	if (hop >= plan.frameSize || plan.frameSize < 3 || !plan.targetCoeff.empty() || plan.decimation > 1)
+		return false;
+
+	// The fast cosine isn't accurate enough for the window to be a sum of cosines
+	double perBin;
+	switch (windowType)
+	{
+	case WindowFunctions::RECTANGLE:	perBin = 1.0; break;
+	case WindowFunctions::VON_HANN:		perBin = 3.0; break;
+	case WindowFunctions::BLACKMAN:		perBin = 5.0; break;
+	default:	return false;
+	}
+	if (fastFunctions && windowType != WindowFunctions::RECTANGLE)
+		return false;
+
+	double sliding = SLIDE_COST * (double)hop * (double)plan.NumBins() * perBin;
+	double transform = (double)plan.N * std::log2((double)plan.N);
+	return sliding < transform;
+}
+
+double SlidingDFT::Phase(size_t resonator, size_t m) const
+{
+	// w * m for the resonator, reduced to [0, 2 pi) without losing precision
+	// for large m
+	size_t bin = plan.firstBin + resonator / perBin;
+	ptrdiff_t shift = (ptrdiff_t)(resonator % perBin) - (ptrdiff_t)(perBin / 2);
+	double binTurns = (double)((bin * m) % plan.N) / (double)plan.N;
+	double shiftTurns = (double)((ptrdiff_t)(m % period) * shift) / (double)period;
+	return 2.0 * M_PI * (binTurns + shiftTurns);
+}
+
+void SlidingDFT::Slide(const double* frame, const double* samples, size_t count)
+{
+	// Without sums to update, the next Execute() starts from scratch anyway
+	if (!valid)
+		return;
+
+	const size_t frameSize = plan.frameSize;
+	const size_t numResonators = sumRe.size();
+	double* re = sumRe.data();
+	double* im = sumIm.data();
+	for (size_t s = 0; s < count; s++)
+	{
+		size_t out = s + offset;
+		double leaving = (out < frameSize) ? frame[out] : samples[out - frameSize];
+		double entering = samples[s];
+
+		for (size_t r = 0; r < numResonators; r++)
+		{
+			double tRe = re[r] - leaving * firstRe[r] + entering * nextRe[r];
+			double tIm = im[r] - leaving * firstIm[r] + entering * nextIm[r];
+			re[r] = tRe * rotateRe[r] - tIm * rotateIm[r];
+			im[r] = tRe * rotateIm[r] + tIm * rotateRe[r];
+		}
+	}
+
+	slid += count;
+}
+
+void SlidingDFT::Execute(const double* frame, double* output)
+{
+	if (!valid || slid >= RESYNC_FRAMES * plan.frameSize)
+		Reset(frame);
+
+	const size_t numBins = plan.NumBins();
+	for (size_t i = 0; i < numBins; i++)
 	{
-		output.push_back(std::make_pair(freq, 2.0f * std::abs(spectrum[k]) / (double)N));
+		double re = 0.0, im = 0.0;
+		for (size_t j = 0; j < perBin; j++)
+		{
+			re += coefficients[j] * sumRe[i * perBin + j];
+			im += coefficients[j] * sumIm[i * perBin + j];
+		}
+		binRe[i] = re;
+		binIm[i] = im;
+	}
+
+	ScaleBins(binRe.data(), binIm.data(), numBins, 2.0 / (double)plan.N, plan.outputScale, plan.floor, output);
+}
+
+void SlidingDFT::Reset(const double* frame)
+{
+	// S = sum of x[m] e^-iwm, with the phasors rotated one sample at a time
+	const size_t numResonators = sumRe.size();
+	std::vector<double> phasorRe(numResonators), phasorIm(numResonators);
+	double* re = sumRe.data();
+	double* im = sumIm.data();
+	std::fill(sumRe.begin(), sumRe.end(), 0.0);
+	std::fill(sumIm.begin(), sumIm.end(), 0.0);
+
+	for (size_t begin = offset; begin < plan.frameSize; begin += PHASOR_BLOCK)
+	{
+		for (size_t r = 0; r < numResonators; r++)
+		{
+			std::complex<double> phasor = std::polar(1.0, -Phase(r, begin));
+			phasorRe[r] = phasor.real();
+			phasorIm[r] = phasor.imag();
+		}
+
+		size_t end = std::min(begin + PHASOR_BLOCK, plan.frameSize);
+		for (size_t m = begin; m < end; m++)
+		{
+			double x = frame[m];
+			for (size_t r = 0; r < numResonators; r++)
+			{
+				re[r] += x * phasorRe[r];
+				im[r] += x * phasorIm[r];
 
-		freq += freqRes;
+				// Multiply with e^-iw
+				double pRe = phasorRe[r] * rotateRe[r] + phasorIm[r] * rotateIm[r];
+				double pIm = phasorIm[r] * rotateRe[r] - phasorRe[r] * rotateIm[r];
+				phasorRe[r] = pRe;
+				phasorIm[r] = pIm;
+			}
+		}
 	}
 
+	slid = 0;
+	valid = true;
+}
+
+std::vector<std::pair<double, double>>
+FFT(const std::vector<double>::const_iterator& begin,
+	const std::vector<double>::const_iterator& end,
+	size_t sampleRate,
+	double minFreq, double maxFreq,
+	unsigned int zeropadding,
+	unsigned int windowWidth)
+{
+	size_t n = end - begin;
+	FFTPlan plan(n, windowWidth, sampleRate, minFreq, maxFreq, zeropadding);
+
+	std::vector<double> magnitudes(plan.NumBins());
+	plan.Execute(n ? &*begin : nullptr, n, magnitudes.data());
+
+	std::vector<std::pair<double, double>> output;
+	for (size_t i = 0; i < magnitudes.size(); i++)
+		output.push_back(std::make_pair(plan.Frequencies()[i], magnitudes[i]));
+
 	return output;
 }
 
-void SetWindowFunction(WindowFunctions func, unsigned int width)
+void SetWindowFunction(WindowFunctions func)
 {
+	windowType = func;
 	switch (func)
 	{
-	case WindowFunctions::RECTANGLE:	window = std::bind(WindowRectangle, std::placeholders::_1, 0, width); break;
-	case WindowFunctions::VON_HANN:		window = std::bind(WindowVonHann, std::placeholders::_1, 0, width); break;
-	case WindowFunctions::GAUSS:		window = std::bind(WindowGauss, std::placeholders::_1, 0, width); break;
-	case WindowFunctions::TRIANGLE:		window = std::bind(WindowTriangle, std::placeholders::_1, 0, width); break;
-	case WindowFunctions::BLACKMAN:		window = std::bind(WindowBlackman, std::placeholders::_1, 0, width); break;
+	case WindowFunctions::RECTANGLE:	window = std::bind(WindowRectangle, std::placeholders::_1, 0, std::placeholders::_2); break;
+	case WindowFunctions::VON_HANN:		window = std::bind(WindowVonHann, std::placeholders::_1, 0, std::placeholders::_2); break;
+	case WindowFunctions::GAUSS:		window = std::bind(WindowGauss, std::placeholders::_1, 0, std::placeholders::_2); break;
+	case WindowFunctions::TRIANGLE:		window = std::bind(WindowTriangle, std::placeholders::_1, 0, std::placeholders::_2); break;
+	case WindowFunctions::BLACKMAN:		window = std::bind(WindowBlackman, std::placeholders::_1, 0, std::placeholders::_2); break;
 	}
 }
 
+void SetEngine(FFTEngines engine)
+{
+	::engine = engine;
+}
+
+void SetScale(Scales scale, double dbFloor)
+{
+	::scale = scale;
+	::dbFloor = dbFloor;
+}
+
 void UseFastFunctions()
 {
+	fastFunctions = true;
 	Sin = std::bind(FastSin, std::placeholders::_1);
 	Cos = std::bind(FastCos, std::placeholders::_1);
 }
 
+void UseDecimation()
+{
+	decimate = true;
+}
+
 inline double WindowRectangle(unsigned int k, unsigned int offset, unsigned int width)
 {
 	return ((offset < k) && (k < width));
@@ -178,6 +990,84 @@ double FastSin(double x)
 	return (double)x - xpow3 * REC_3_FAC + xpow5 * REC_5_FAC - xpow7 * REC_7_FAC + xpow7 * x * x * REC_9_FAC;
 }
 
+// log10 for positive, finite x without branches or calls, so loops using it
+// can be vectorized. x = m * 2^e with m in [sqrt(1/2), sqrt(2)), then
+// ln(m) = 2 atanh(s) with s = (m - 1) / (m + 1), |s| < 0.172. The series is
+// cut off after s^11, which leaves a relative error below 1e-10
+inline double FastLog10(double x)
+{
+	uint64_t bits;
+	std::memcpy(&bits, &x, sizeof(bits));
+
+	// Move the mantissa into [sqrt(1/2), sqrt(2)) and adjust the exponent for it
+	int64_t e = (int64_t)((bits >> 52) & 0x7FF) - 1023;
+	bits = (bits & 0x000FFFFFFFFFFFFFull) | 0x3FF0000000000000ull;
+	double m;
+	std::memcpy(&m, &bits, sizeof(m));
+
+	bool high = m >= M_SQRT2;
+	m = high ? m * 0.5 : m;
+	e += high;
+
+	double s = (m - 1.0) / (m + 1.0);
+	double s2 = s * s;
+	double series = s * (2.0 + s2 * (2.0 / 3.0 + s2 * (2.0 / 5.0 + s2 * (2.0 / 7.0 + s2 * (2.0 / 9.0 + s2 * (2.0 / 11.0))))));
+
+	return ((double)e * M_LN2 + series) * M_LOG10E;
+}
+
+// Everything up to maxFreq passes the anti-alias filter, everything from the
+// decimated sample rate minus maxFreq on would fold back into the range and is
+// blocked. The Kaiser window needs this many taps on either side for that
+size_t FilterHalfLength(size_t sampleRate, size_t decimation, double maxFreq)
+{
+	double transition = 2.0 * M_PI * ((double)sampleRate / (double)decimation - 2.0 * maxFreq) / (double)sampleRate;
+	return (size_t)std::ceil((DECIMATION_ATTENUATION_DB - 8.0) / (2.285 * transition) / 2.0);
+}
+
+// Modified Bessel function of the first kind of order 0, for the Kaiser
+// window: sum of ((x / 2)^k / k!)^2, until the terms don't matter anymore
+double BesselI0(double x)
+{
+	double sum = 1.0, term = 1.0;
+	for (int k = 1; term > sum * 1e-17; k++)
+	{
+		double factor = x / (2.0 * (double)k);
+		term *= factor * factor;
+		sum += term;
+	}
+	return sum;
+}
+
+// No overflow is possible here, so sqrt does what std::hypot does
+inline void ScaleBins(const double* re, const double* im, size_t numBins, double factor, Scales scale, double floor, double* output)
+{
+	switch (scale)
+	{
+	case Scales::LINEAR:
+		for (size_t i = 0; i < numBins; i++)
+			output[i] = factor * std::sqrt(re[i] * re[i] + im[i] * im[i]);
+		break;
+
+	case Scales::POWER:
+		for (size_t i = 0; i < numBins; i++)
+			output[i] = factor * factor * (re[i] * re[i] + im[i] * im[i]);
+		break;
+
+	case Scales::DECIBEL:
+	{
+		// Everything below the floor is clamped, which also takes care of log(0)
+		const double powerFloor = std::pow(10.0, floor / 10.0);
+		for (size_t i = 0; i < numBins; i++)
+		{
+			double power = factor * factor * (re[i] * re[i] + im[i] * im[i]);
+			output[i] = (power > powerFloor) ? 10.0 * FastLog10(power) : floor;
+		}
+		break;
+	}
+	}
+}
+
 std::complex<double> ComplexExp(double x)
 {
 	return std::complex<double>(Cos(x), Sin(x));
@@ -1,6 +1,9 @@
 #pragma once
 #include <vector>
 #include <complex>
+#include <cstdint>
+
+#include "Scratch.hpp"
 
 enum class WindowFunctions {
 	RECTANGLE,
@@ -10,11 +13,156 @@ enum class WindowFunctions {
 	BLACKMAN
 };
 
+enum class FFTEngines {
+	AUTO,
+	RADIX2,
+	SPLIT_RADIX,
+	FOUR_STEP
+};
+
+// What the values of a spectrum are: amplitude (2|X|/N), power (the square of
+// that) or power in dB
+enum class Scales {
+	LINEAR,
+	POWER,
+	DECIBEL
+};
+
 extern std::vector<std::pair<double, double>> FFT(const std::vector<double>::const_iterator& begin,
 	const std::vector<double>::const_iterator& end,
 	size_t sampleRate,
 	double minFreq, double maxFreq,
-	unsigned int zeropadding);
+	unsigned int zeropadding,
+	unsigned int windowWidth);
+
+struct Workspace;
+
+/*
+ * Everything about the transform of a frame that is the same for all frames:
+ * transform size, engine, window, twiddle factors and the bins that end up in
+ * the output. A plan doesn't change after construction, so all threads can
+ * share one.
+ *
+ * If targets are given, only those frequencies are computed, each with
+ * Goertzel's algorithm in O(frameSize), instead of a full transform. The
+ * values are scaled like those of the FFT of the same size, so a target that
+ * lies on a bin gives the same value as that bin.
+ *
+ * With UseDecimation(), frames whose frequency range ends far below Nyquist
+ * are low-pass filtered and only every 2nd, 4th, ... sample is transformed.
+ * The transform shrinks by that factor, the bins stay where they are
+ */
+class FFTPlan
+{
+public:
+	FFTPlan(size_t frameSize, unsigned int windowWidth, size_t sampleRate,
+		double minFreq, double maxFreq, unsigned int zeropadding,
+		const std::vector<double>& targets = {});
+	~FFTPlan();
+
+	// Transforms n <= FrameSize() samples and writes the scaled magnitude of
+	// every bin in the frequency range to output (NumBins() values), in the
+	// scale set with SetScale()
+	void Execute(const double* samples, size_t n, double* output) const;
+
+	size_t FrameSize() const { return frameSize; }
+	size_t Size() const { return N; }
+	size_t NumBins() const { return frequencies.size(); }
+
+	// The frequency of each output bin
+	const std::vector<double>& Frequencies() const { return frequencies; }
+
+	// Transform size for frames of the given size: the next power of two,
+	// times 2^(zeropadding - 1)
+	static size_t PaddedSize(size_t frameSize, unsigned int zeropadding);
+
+	// Upper bounds for the memory of a plan with these parameters, and of the
+	// workspace every running transform of it needs. Known before the plan exists
+	static size_t Memory(size_t frameSize, unsigned int windowWidth, unsigned int zeropadding);
+	static size_t WorkspaceMemory(size_t frameSize, unsigned int zeropadding);
+
+private:
+	friend class SlidingDFT;
+
+	void ExecuteGoertzel(const double* samples, size_t n, double* output, Workspace& workspace) const;
+
+	// Windows and filters n samples and writes every decimation-th of them to
+	// workspace.decimated, wrapped around to N values
+	void Decimate(const double* samples, size_t n, Workspace& workspace) const;
+
+	size_t frameSize, N;
+	size_t decimation;
+	size_t firstBin;
+	FFTEngines engineType;
+	const uint16_t* reverse;
+	Scales outputScale;
+	double floor;
+
+	std::vector<double> frequencies;
+	std::vector<double> window;
+	std::vector<double> twiddleRe, twiddleIm;
+	std::vector<double> highRe, highIm, lowRe, lowIm;
+
+	// Goertzel: 2 cos(w), and e^-iw to get the bin out of the last two states
+	std::vector<double> targetCoeff, targetCos, targetSin;
+
+	// Anti-alias filter of the decimation, centered on the middle tap. Its
+	// input is windowed already, so the decimated samples get a window of 1s
+	std::vector<double> taps;
+	std::vector<double> unitWindow;
+
+	// Buffers of the transforms that are running, kept for the next ones
+	mutable ScratchPool<Workspace> workspaces;
+};
+
+/*
+ * The spectrum of a plan for a frame that moves forward a few samples at a
+ * time. Instead of transforming every frame, each bin is kept as a running
+ * sum that is updated in O(bins) per new sample. Windows that are sums of
+ * cosines (rectangle, von Hann, Blackman) are the sum of 1, 3 or 5 such
+ * resonators per bin. Rounding errors add up with every update, so the sums
+ * are recomputed from the frame every RESYNC_FRAMES frame lengths
+ */
+class SlidingDFT
+{
+public:
+	SlidingDFT(const FFTPlan& plan);
+
+	// Whether sliding hop samples per frame is cheaper than transforming every
+	// frame with the plan, and the window can be computed this way at all
+	static bool Faster(const FFTPlan& plan, size_t hop);
+
+	// Moves the frame count <= FrameSize() samples forward. frame is the
+	// frame before the move, samples the count samples that are added
+	void Slide(const double* frame, const double* samples, size_t count);
+
+	// Writes the spectrum of frame, the current frame, like FFTPlan::Execute()
+	void Execute(const double* frame, double* output);
+
+private:
+	static constexpr size_t RESYNC_FRAMES = 16;
+
+	// Phase of resonator after m samples
+	double Phase(size_t resonator, size_t m) const;
+
+	// Computes the sums from scratch
+	void Reset(const double* frame);
+
+	const FFTPlan& plan;
+	size_t offset, period;
+	size_t perBin;
+	size_t slid;
+	bool valid;
+
+	// Weights of the resonators of a bin, at w - 2 pi j / P ... w + 2 pi j / P
+	std::vector<double> coefficients;
+	std::vector<double> rotateRe, rotateIm, firstRe, firstIm, nextRe, nextIm;
+	std::vector<double> sumRe, sumIm;
+	std::vector<double> binRe, binIm;
+};
 
-extern void SetWindowFunction(WindowFunctions func, unsigned int width);
-extern void UseFastFunctions();
\ No newline at end of file
+extern void SetWindowFunction(WindowFunctions func);
+extern void SetEngine(FFTEngines engine);
+extern void SetScale(Scales scale, double dbFloor);
+extern void UseFastFunctions();
+extern void UseDecimation();
\ No newline at end of file
@@ -0,0 +1,178 @@
+#pragma once
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Compile-time specialized radix-2 kernels for the frame sizes that show up
+ * most often (256 - 4096). The size is a template parameter, the twiddle
+ * factors and the bit-reversal permutation are generated as constexpr tables,
+ * and every stage has a compile-time trip count so the compiler can unroll and
+ * keep the butterflies in registers.
+ */
+namespace FixedFFT
+{
+	constexpr double PI = 3.14159265358979323846;
+
+	// Taylor series, only accurate for |x| <= pi/4
+	constexpr double TaylorSin(double x)
+	{
+		double term = x, sum = x;
+		for (int n = 1; n < 12; n++)
+		{
+			term *= -x * x / (double)((2 * n) * (2 * n + 1));
+			sum += term;
+		}
+		return sum;
+	}
+
+	constexpr double TaylorCos(double x)
+	{
+		double term = 1.0, sum = 1.0;
+		for (int n = 1; n < 12; n++)
+		{
+			term *= -x * x / (double)((2 * n - 1) * (2 * n));
+			sum += term;
+		}
+		return sum;
+	}
+
+	// cos/sin of 2*pi*k/N for 0 <= k < N/2. The range reduction is done on the
+	// integer k so no precision is lost before the series is evaluated
+	constexpr void UnitRoot(size_t k, size_t N, double& c, double& s)
+	{
+		double sign = 1.0;
+		if (4 * k > N)
+		{
+			k = N / 2 - k;
+			sign = -1.0;
+		}
+
+		if (8 * k > N)
+		{
+			double x = 2.0 * PI * (double)(N / 4 - k) / (double)N;
+			c = sign * TaylorSin(x);
+			s = TaylorCos(x);
+		}
+		else
+		{
+			double x = 2.0 * PI * (double)k / (double)N;
+			c = sign * TaylorCos(x);
+			s = TaylorSin(x);
+		}
+	}
+
+	template<size_t N>
+	struct Tables
+	{
+		double re[N / 2];
+		double im[N / 2];
+		uint16_t reverse[N];
+
+		constexpr Tables() : re(), im(), reverse()
+		{
+			for (size_t k = 0; k < N / 2; k++)
+			{
+				double c = 0.0, s = 0.0;
+				UnitRoot(k, N, c, s);
+				re[k] = c;
+				im[k] = -s;		// exp(-2*pi*i*k/N)
+			}
+
+			size_t bits = 0;
+			while (((size_t)1 << bits) < N)
+				bits++;
+
+			for (size_t i = 0; i < N; i++)
+			{
+				size_t r = 0;
+				for (size_t b = 0; b < bits; b++)
+					r |= ((i >> b) & 1) << (bits - 1 - b);
+				reverse[i] = (uint16_t)r;
+			}
+		}
+	};
+
+	template<size_t N>
+	constexpr Tables<N> TABLES{};
+
+	// One radix-2 pass over blocks of length Len, recursing into the next pass
+	template<size_t N, size_t Len>
+	struct Stage
+	{
+		static inline void Run(double* re, double* im)
+		{
+			constexpr size_t half = Len / 2;
+			constexpr size_t stride = N / Len;
+
+			for (size_t block = 0; block < N; block += Len)
+			{
+				for (size_t k = 0; k < half; k++)
+				{
+					const double wr = TABLES<N>.re[k * stride];
+					const double wi = TABLES<N>.im[k * stride];
+
+					const size_t a = block + k;
+					const size_t b = a + half;
+					const double qr = re[b] * wr - im[b] * wi;
+					const double qi = re[b] * wi + im[b] * wr;
+
+					re[b] = re[a] - qr;
+					im[b] = im[a] - qi;
+					re[a] += qr;
+					im[a] += qi;
+				}
+			}
+
+			Stage<N, Len * 2>::Run(re, im);
+		}
+	};
+
+	// The first two passes only need the twiddles 1 and -i, so they are fused
+	// into a multiplication-free radix-4 codelet
+	template<size_t N>
+	struct Stage<N, 4>
+	{
+		static inline void Run(double* re, double* im)
+		{
+			for (size_t i = 0; i < N; i += 4)
+			{
+				const double ar = re[i] + re[i + 1], ai = im[i] + im[i + 1];
+				const double br = re[i] - re[i + 1], bi = im[i] - im[i + 1];
+				const double cr = re[i + 2] + re[i + 3], ci = im[i + 2] + im[i + 3];
+				const double dr = re[i + 2] - re[i + 3], di = im[i + 2] - im[i + 3];
+
+				re[i] = ar + cr;		im[i] = ai + ci;
+				re[i + 2] = ar - cr;	im[i + 2] = ai - ci;
+				re[i + 1] = br + di;	im[i + 1] = bi - dr;
+				re[i + 3] = br - di;	im[i + 3] = bi + dr;
+			}
+
+			Stage<N, 8>::Run(re, im);
+		}
+	};
+
+	template<size_t N>
+	struct Stage<N, N * 2>
+	{
+		static inline void Run(double*, double*) { }
+	};
+
+	// Position of sample i in the bit-reversed input of Transform<N>
+	template<size_t N>
+	constexpr const uint16_t* Reverse()
+	{
+		return TABLES<N>.reverse;
+	}
+
+	/*
+	 * Transforms the N points in re/im in-place. The input has to be stored
+	 * in bit-reversed order already (see Reverse), the output is in natural order
+	 */
+	template<size_t N>
+	inline void Transform(double* re, double* im)
+	{
+		static_assert(N >= 4 && (N & (N - 1)) == 0, "FixedFFT needs a power of two >= 4");
+		Stage<N, 4>::Run(re, im);
+	}
+}
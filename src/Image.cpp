@@ -0,0 +1,233 @@
+#include "Image.hpp"
+#include "Deflate.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <string>
+
+// Samples of matplotlib's viridis, the rest is interpolated linearly
+constexpr uint8_t VIRIDIS[9][3] = {
+	{ 68, 1, 84 },
+	{ 71, 44, 122 },
+	{ 59, 81, 139 },
+	{ 44, 113, 142 },
+	{ 33, 144, 141 },
+	{ 39, 173, 129 },
+	{ 92, 200, 99 },
+	{ 170, 220, 50 },
+	{ 253, 231, 37 }
+};
+
+static std::array<uint8_t, 3> Color(Colormaps colormap, uint8_t level)
+{
+	if (colormap == Colormaps::GRAY)
+		return { level, level, level };
+
+	double pos = level / 255.0 * 8.0;
+	int i = std::min((int)pos, 7);
+	double t = pos - i;
+
+	std::array<uint8_t, 3> rgb;
+	for (int c = 0; c < 3; c++)
+		rgb[c] = (uint8_t)std::lround(VIRIDIS[i][c] + t * (VIRIDIS[i + 1][c] - VIRIDIS[i][c]));
+
+	return rgb;
+}
+
+// Compressed PNG data is written in IDAT chunks of about this size
+constexpr size_t IDAT_SIZE = 64 * 1024;
+
+// Columns and rows per channel for an --image-size of 0
+static size_t ImageSize(unsigned int size, size_t count, unsigned int maximum)
+{
+	return size ? size : std::min<size_t>(std::max<size_t>(count, 1), maximum);
+}
+
+static void PutBigEndian(std::vector<uint8_t>& buffer, uint32_t value)
+{
+	for (int shift = 24; shift >= 0; shift -= 8)
+		buffer.push_back((uint8_t)(value >> shift));
+}
+
+static void WriteChunk(std::ostream& out, const char* type, const std::vector<uint8_t>& data)
+{
+	std::vector<uint8_t> chunk;
+	PutBigEndian(chunk, (uint32_t)data.size());
+	chunk.insert(chunk.end(), type, type + 4);
+	chunk.insert(chunk.end(), data.begin(), data.end());
+	PutBigEndian(chunk, Crc32(chunk.data() + 4, chunk.size() - 4));
+
+	out.write((const char*)chunk.data(), chunk.size());
+}
+
+ImageWriter::ImageWriter(std::ostream& out, ImageFormats format, Colormaps colormap,
+	unsigned int width, unsigned int height,
+	unsigned int numChannels, size_t numFrames, size_t numBins,
+	Scales scale, double dbFloor) :
+	out(out), format(format), colormap(colormap), width(width), height(height),
+	numFrames(std::max<size_t>(numFrames, 1)), scale(scale), dbFloor(dbFloor), channel(0), frame(0)
+{
+	this->width = (unsigned int)ImageSize(width, numFrames, MAX_WIDTH);
+	this->height = (unsigned int)ImageSize(height, numBins, MAX_HEIGHT);
+
+	pixels.assign((size_t)this->width * this->height * numChannels, 0);
+}
+
+size_t ImageWriter::Memory(unsigned int width, unsigned int height,
+	unsigned int numChannels, size_t numFrames, size_t numBins)
+{
+	size_t columns = ImageSize(width, numFrames, MAX_WIDTH);
+	size_t pixels = columns * ImageSize(height, numBins, MAX_HEIGHT) * numChannels;
+
+	// The pixels, and for PNG one RGB scanline and the compressed data of
+	// the IDAT chunk that is being filled
+	return pixels + 3 * columns + 1 + 2 * IDAT_SIZE + Deflater::Memory();
+}
+
+void ImageWriter::BeginChannel(unsigned int)
+{
+	frame = 0;
+}
+
+void ImageWriter::WriteFrame(size_t, size_t, const FFTPlan& plan, const double* values)
+{
+	size_t numBins = plan.NumBins();
+
+	levels.resize(numBins);
+	for (size_t i = 0; i < numBins; i++)
+		levels[i] = Level(values[i]);
+
+	// Columns covered by this frame, one or more frames share a column when
+	// the image is narrower than the number of frames
+	size_t x0 = frame * width / numFrames;
+	size_t x1 = std::max(x0 + 1, (frame + 1) * width / numFrames);
+
+	uint8_t* band = pixels.data() + (size_t)channel * width * height;
+	for (size_t y = 0; y < height && numBins > 0; y++)
+	{
+		size_t lo = std::min(y * numBins / height, numBins - 1);
+		size_t hi = std::max(lo + 1, (y + 1) * numBins / height);
+		uint8_t level = *std::max_element(levels.begin() + lo, levels.begin() + hi);
+
+		// Low frequencies at the bottom
+		uint8_t* row = band + (height - 1 - y) * width;
+		for (size_t x = x0; x < x1; x++)
+			row[x] = std::max(row[x], level);
+	}
+
+	frame++;
+}
+
+void ImageWriter::EndChannel()
+{
+	channel++;
+}
+
+// The image can only be encoded once every frame is in
+void ImageWriter::Flush()
+{
+}
+
+void ImageWriter::Finish()
+{
+	size_t rows = pixels.size() / width;
+	if (format == ImageFormats::PNG)
+	{
+		WritePNG();
+	}
+	else if (format == ImageFormats::PGM)
+	{
+		out << "P5\n" << width << " " << rows << "\n255\n";
+		out.write((const char*)pixels.data(), pixels.size());
+	}
+	else
+	{
+		out << "P6\n" << width << " " << rows << "\n255\n";
+
+		std::vector<uint8_t> line(3 * (size_t)width);
+		for (size_t y = 0; y < rows; y++)
+		{
+			for (size_t x = 0; x < width; x++)
+			{
+				std::array<uint8_t, 3> rgb = Color(colormap, pixels[y * width + x]);
+				std::copy(rgb.begin(), rgb.end(), line.begin() + 3 * x);
+			}
+			out.write((const char*)line.data(), line.size());
+		}
+	}
+
+	out.flush();
+}
+
+// Maps a value of the output scale to 0 (dbFloor or quieter) ... 255 (0dB)
+uint8_t ImageWriter::Level(double value) const
+{
+	double db;
+	switch (scale)
+	{
+	case Scales::LINEAR: db = 20.0 * std::log10(value); break;
+	case Scales::POWER: db = 10.0 * std::log10(value); break;
+	default: db = value; break;
+	}
+
+	if (!(db > dbFloor))
+		return 0;
+	if (db >= 0.0)
+		return 255;
+
+	return (uint8_t)std::lround((db - dbFloor) / -dbFloor * 255.0);
+}
+
+// 8-bit RGB, or grayscale for the gray colormap
+void ImageWriter::WritePNG()
+{
+	const bool gray = (colormap == Colormaps::GRAY);
+	const size_t channels = gray ? 1 : 3;
+	const size_t rows = pixels.size() / width;
+
+	const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	out.write((const char*)signature, sizeof(signature));
+
+	std::vector<uint8_t> header;
+	PutBigEndian(header, width);
+	PutBigEndian(header, (uint32_t)rows);
+	header.push_back(8);				// Bit depth
+	header.push_back(gray ? 0 : 2);		// Color type
+	header.push_back(0);				// Compression
+	header.push_back(0);				// Filter
+	header.push_back(0);				// Interlace
+	WriteChunk(out, "IHDR", header);
+
+	// Scanlines are compressed one after the other, and the compressed data
+	// is written as soon as an IDAT chunk is full. Every scanline starts with
+	// its filter type, 0 = none
+	std::vector<uint8_t> line(1 + channels * width);
+	std::vector<uint8_t> data;
+	Deflater deflater(Containers::ZLIB);
+	for (size_t y = 0; y < rows; y++)
+	{
+		line[0] = 0;
+		for (size_t x = 0; x < width; x++)
+		{
+			uint8_t level = pixels[y * width + x];
+			if (gray)
+			{
+				line[1 + x] = level;
+			}
+			else
+			{
+				std::array<uint8_t, 3> rgb = Color(colormap, level);
+				std::copy(rgb.begin(), rgb.end(), line.begin() + 1 + 3 * x);
+			}
+		}
+
+		deflater.Compress(line.data(), line.size(), data, y + 1 == rows);
+		if (data.size() >= IDAT_SIZE || y + 1 == rows)
+		{
+			WriteChunk(out, "IDAT", data);
+			data.clear();
+		}
+	}
+	WriteChunk(out, "IEND", {});
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "Writer.hpp"
+
+enum class ImageFormats {
+	PNG,
+	PPM,
+	PGM
+};
+
+enum class Colormaps {
+	VIRIDIS,
+	GRAY
+};
+
+/*
+ * Renders a spectrogram: time from left to right, frequency from bottom to top
+ * and one band per channel, stacked from top to bottom. Values are converted to
+ * dB and mapped from [dbFloor, 0dB] to the colormap.
+ *
+ * Frames are folded into an 8-bit pixel buffer as they come in, so memory only
+ * depends on the size of the image. Without a size, there is one column per
+ * frame and one row per bin, but no more than MAX_WIDTH/MAX_HEIGHT, so long
+ * files don't make the image grow without bound. If there are more frames/bins
+ * than pixels, a pixel shows the loudest of them.
+ */
+class ImageWriter : public SpectrumWriter
+{
+public:
+	// Largest width/height per channel that 0 picks
+	static constexpr unsigned int MAX_WIDTH = 4096;
+	static constexpr unsigned int MAX_HEIGHT = 2048;
+
+	// width/height of 0 mean one column per frame/one row per bin, up to
+	// MAX_WIDTH/MAX_HEIGHT
+	ImageWriter(std::ostream& out, ImageFormats format, Colormaps colormap,
+		unsigned int width, unsigned int height,
+		unsigned int numChannels, size_t numFrames, size_t numBins,
+		Scales scale, double dbFloor);
+
+	void BeginChannel(unsigned int channel) override;
+	void WriteFrame(size_t begin, size_t end, const FFTPlan& plan, const double* values) override;
+	void EndChannel() override;
+	void Flush() override;
+	void Finish() override;
+
+	// Most memory an image with these parameters takes, including encoding it
+	static size_t Memory(unsigned int width, unsigned int height,
+		unsigned int numChannels, size_t numFrames, size_t numBins);
+
+private:
+	uint8_t Level(double value) const;
+
+	void WritePNG();
+
+	std::ostream& out;
+	ImageFormats format;
+	Colormaps colormap;
+	unsigned int width, height;
+	size_t numFrames;
+	Scales scale;
+	double dbFloor;
+
+	unsigned int channel;
+	size_t frame;
+
+	std::vector<uint8_t> pixels;
+	std::vector<uint8_t> levels;
+};
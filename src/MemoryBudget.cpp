@@ -0,0 +1,57 @@
+#include "MemoryBudget.hpp"
+
+MemoryBudget::MemoryBudget(ThreadPool& pool, size_t limit) :
+	pool(pool), limit(limit), used(0)
+{
+}
+
+bool MemoryBudget::Fits(size_t size)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	return used + size <= limit;
+}
+
+void MemoryBudget::Acquire(size_t size)
+{
+	if (limit == 0)
+		return;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			if (used + size <= limit)
+			{
+				used += size;
+				return;
+			}
+		}
+
+		// Memory is only given back by tasks, so help them finish
+		if (!pool.RunPendingTask())
+			pool.WaitForWork([&]() { return Fits(size); });
+	}
+}
+
+void MemoryBudget::Release(size_t size)
+{
+	if (limit == 0)
+		return;
+
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		used -= size;
+	}
+	pool.Notify();
+}
+
+MemoryReservation::MemoryReservation(MemoryBudget& budget, size_t size) :
+	budget(budget), size(size)
+{
+	budget.Acquire(size);
+}
+
+MemoryReservation::~MemoryReservation()
+{
+	budget.Release(size);
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <mutex>
+
+#include "ThreadPool.hpp"
+
+/*
+ * Upper limit for the memory of everything that is being worked on at the same
+ * time. Work reserves the memory it needs before allocating it, and waits until
+ * enough is free, so going over the limit slows things down instead of
+ * running out of memory. A limit of 0 means no limit.
+ */
+class MemoryBudget
+{
+public:
+	MemoryBudget(ThreadPool& pool, size_t limit);
+
+	size_t Limit() const { return limit; }
+
+	// Waits until size bytes are free, executing queued tasks meanwhile like
+	// TaskGroup::Wait(). size must not be larger than the limit, and the caller
+	// must not hold memory of the budget itself, or it may wait for itself
+	void Acquire(size_t size);
+	void Release(size_t size);
+
+private:
+	bool Fits(size_t size);
+
+	ThreadPool& pool;
+	size_t limit, used;
+	std::mutex mutex;
+};
+
+// Holds memory of a budget for as long as it lives
+class MemoryReservation
+{
+public:
+	MemoryReservation(MemoryBudget& budget, size_t size);
+	~MemoryReservation();
+
+	MemoryReservation(const MemoryReservation&) = delete;
+	MemoryReservation& operator=(const MemoryReservation&) = delete;
+
+private:
+	MemoryBudget& budget;
+	size_t size;
+};
@@ -0,0 +1,74 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/*
+ * Pool of reusable scratch objects (buffers, tables, ...), owned by whatever
+ * needs them, like a plan. Objects are lent out for as long as a Scratch lives
+ * and go back to the pool afterwards, so buffers that only ever grow stop
+ * allocating once the first frame of a given size is done, and there are never
+ * more objects than were in use at the same time.
+ *
+ * A thread that waits for subtasks helps executing other tasks, which may need
+ * an object of the same pool while the outer one is still in use. They simply
+ * get another one. The objects are freed with the pool, so they don't outlive
+ * the memory reserved for the file they were used for.
+ */
+template<typename T>
+class ScratchPool
+{
+public:
+	ScratchPool() = default;
+	ScratchPool(const ScratchPool&) = delete;
+	ScratchPool& operator=(const ScratchPool&) = delete;
+
+	std::unique_ptr<T> Take()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!items.empty())
+			{
+				std::unique_ptr<T> item = std::move(items.back());
+				items.pop_back();
+				return item;
+			}
+		}
+		return std::make_unique<T>();
+	}
+
+	void Return(std::unique_ptr<T> item)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		items.push_back(std::move(item));
+	}
+
+private:
+	std::mutex mutex;
+	std::vector<std::unique_ptr<T>> items;
+};
+
+template<typename T>
+class Scratch
+{
+public:
+	Scratch(ScratchPool<T>& pool) :
+		pool(pool), item(pool.Take())
+	{
+	}
+
+	~Scratch()
+	{
+		pool.Return(std::move(item));
+	}
+
+	Scratch(const Scratch&) = delete;
+	Scratch& operator=(const Scratch&) = delete;
+
+	T& operator*() { return *item; }
+	T* operator->() { return item.get(); }
+
+private:
+	ScratchPool<T>& pool;
+	std::unique_ptr<T> item;
+};
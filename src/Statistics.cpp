@@ -0,0 +1,141 @@
+#include "Statistics.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+PowerAverage::PowerAverage(size_t numBins) :
+	count(0), sums(numBins, 0.0)
+{
+}
+
+void PowerAverage::Add(const double* power)
+{
+	for (size_t i = 0; i < sums.size(); i++)
+		sums[i] += power[i];
+	count++;
+}
+
+void PowerAverage::Merge(const PowerAverage& other)
+{
+	for (size_t i = 0; i < sums.size(); i++)
+		sums[i] += other.sums[i];
+	count += other.count;
+}
+
+void PowerAverage::Mean(double* output) const
+{
+	double factor = count ? 1.0 / (double)count : 0.0;
+	for (size_t i = 0; i < sums.size(); i++)
+		output[i] = sums[i] * factor;
+}
+
+SpectrumStats::SpectrumStats(size_t numBins, double dbFloor, bool percentiles) :
+	numBins(numBins), numBuckets(percentiles ? NumBuckets(dbFloor) : 0), dbFloor(dbFloor),
+	min(numBins, std::numeric_limits<double>::infinity()), max(numBins, -std::numeric_limits<double>::infinity()),
+	counts(numBins * numBuckets, 0)
+{
+}
+
+size_t SpectrumStats::NumBuckets(double dbFloor)
+{
+	// Parse keeps the floor in range, but never let a bad one turn into a
+	// negative or huge count. One extra for everything at or below the floor
+	double range = CEILING_DB - dbFloor;
+	if (!(range >= BUCKET_DB))
+		range = BUCKET_DB;
+	range = std::min(range, CEILING_DB - LOWEST_FLOOR_DB);
+	return (size_t)std::ceil(range / BUCKET_DB) + 1;
+}
+
+size_t SpectrumStats::Memory(size_t numBins, double dbFloor, bool percentiles)
+{
+	return numBins * (2 * sizeof(double) + (percentiles ? NumBuckets(dbFloor) * sizeof(uint32_t) : 0));
+}
+
+void SpectrumStats::Add(const double* power, size_t count, size_t stride, size_t first, size_t last)
+{
+	const double powerFloor = std::pow(10.0, dbFloor / 10.0);
+	for (size_t frame = 0; frame < count; frame++)
+	{
+		const double* values = power + frame * stride;
+		for (size_t i = first; i < last; i++)
+		{
+			double value = values[i];
+			min[i] = std::min(min[i], value);
+			max[i] = std::max(max[i], value);
+
+			if (numBuckets)
+			{
+				size_t bucket = 0;
+				if (value > powerFloor)
+				{
+					double position = std::ceil((10.0 * std::log10(value) - dbFloor) / BUCKET_DB);
+					bucket = (size_t)std::min(std::max(position, 1.0), (double)(numBuckets - 1));
+				}
+				counts[i * numBuckets + bucket]++;
+			}
+		}
+	}
+}
+
+void SpectrumStats::Min(double* output) const
+{
+	std::copy(min.begin(), min.end(), output);
+}
+
+void SpectrumStats::Max(double* output) const
+{
+	std::copy(max.begin(), max.end(), output);
+}
+
+void SpectrumStats::Percentile(double p, double* output) const
+{
+	for (size_t i = 0; i < numBins; i++)
+	{
+		const uint32_t* bins = counts.data() + i * numBuckets;
+		uint64_t total = 0;
+		for (size_t b = 0; b < numBuckets; b++)
+			total += bins[b];
+		if (total == 0)
+		{
+			output[i] = 0.0;
+			continue;
+		}
+
+		uint64_t rank = std::max<uint64_t>((uint64_t)std::ceil(p / 100.0 * (double)total), 1);
+		uint64_t seen = 0;
+		size_t bucket = 0;
+		for (; bucket < numBuckets - 1; bucket++)
+		{
+			seen += bins[bucket];
+			if (seen >= rank)
+				break;
+		}
+
+		double db = (bucket == 0) ? dbFloor : dbFloor + ((double)bucket - 0.5) * BUCKET_DB;
+		output[i] = std::min(std::max(std::pow(10.0, db / 10.0), min[i]), max[i]);
+	}
+}
+
+void ScalePower(double* values, size_t count, Scales scale, double dbFloor)
+{
+	switch (scale)
+	{
+	case Scales::LINEAR:
+		for (size_t i = 0; i < count; i++)
+			values[i] = std::sqrt(values[i]);
+		break;
+
+	case Scales::POWER:
+		break;
+
+	case Scales::DECIBEL:
+	{
+		const double powerFloor = std::pow(10.0, dbFloor / 10.0);
+		for (size_t i = 0; i < count; i++)
+			values[i] = (values[i] > powerFloor) ? 10.0 * std::log10(values[i]) : dbFloor;
+		break;
+	}
+	}
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "FFT.hpp"
+
+// How the spectra of all frames are summarized into one per channel
+enum class PSDMethods {
+	NONE,
+	WELCH
+};
+
+enum class StatTypes {
+	MIN,
+	MAX,
+	MEAN,
+	PERCENTILE
+};
+
+// One of the spectra --stats writes per channel, e.g. "p90"
+struct Stat {
+	StatTypes type;
+	double percentile;
+	std::string name;
+};
+
+/*
+ * Mean of power spectra, one value per bin. Every thread sums its own frames
+ * and the partial sums are combined with Merge(), so frames never have to be
+ * kept around
+ */
+class PowerAverage
+{
+public:
+	PowerAverage(size_t numBins);
+
+	void Add(const double* power);
+	void Merge(const PowerAverage& other);
+
+	size_t Count() const { return count; }
+
+	// Writes the mean power of every bin, 0 if nothing was added
+	void Mean(double* output) const;
+
+private:
+	size_t count;
+	std::vector<double> sums;
+};
+
+/*
+ * Per-bin minimum, maximum and distribution of power spectra, the way a
+ * spectrum analyzer shows min/max hold. The distribution is a histogram of
+ * BUCKET_DB wide buckets between the dB floor and CEILING_DB, so percentiles
+ * are accurate to BUCKET_DB / 2 and the memory doesn't depend on the number
+ * of frames. Everything below the floor falls into the first bucket and
+ * everything above the ceiling into the last.
+ *
+ * Bins are independent of each other, so different threads can add
+ * different ranges of bins of the same frames at the same time. Counts are
+ * integers, so the order frames are added in doesn't matter either
+ */
+class SpectrumStats
+{
+public:
+	// Without percentiles only the minimum and maximum are kept
+	SpectrumStats(size_t numBins, double dbFloor, bool percentiles);
+
+	// Adds the bins [first, last) of count spectra that are stride values apart
+	void Add(const double* power, size_t count, size_t stride, size_t first, size_t last);
+
+	void Min(double* output) const;
+	void Max(double* output) const;
+
+	// p in [0, 100], the center of the bucket the percentile falls into
+	// (nearest rank), limited to the minimum and maximum of the bin
+	void Percentile(double p, double* output) const;
+
+	static size_t Memory(size_t numBins, double dbFloor, bool percentiles);
+
+private:
+	static constexpr double BUCKET_DB = 0.2;
+	static constexpr double CEILING_DB = 40.0;
+	static constexpr double LOWEST_FLOOR_DB = -400.0;
+
+	static size_t NumBuckets(double dbFloor);
+
+	size_t numBins, numBuckets;
+	double dbFloor;
+	std::vector<double> min, max;
+	std::vector<uint32_t> counts;
+};
+
+// Turns power values into the given scale, like FFTPlan::Execute() does
+extern void ScalePower(double* values, size_t count, Scales scale, double dbFloor);
@@ -0,0 +1,61 @@
+#include "Stream.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+SampleRing::SampleRing(size_t size) :
+	size(size), next(0), data(2 * size, 0.0)
+{
+}
+
+void SampleRing::Push(const double* samples, size_t count)
+{
+	// Only the last size samples can end up in a frame
+	if (count > size)
+	{
+		samples += count - size;
+		count = size;
+	}
+
+	while (count > 0)
+	{
+		size_t n = std::min(count, size - next);
+		std::memcpy(data.data() + next, samples, n * sizeof(double));
+		std::memcpy(data.data() + next + size, samples, n * sizeof(double));
+
+		next = (next + n) % size;
+		samples += n;
+		count -= n;
+	}
+}
+
+LatencyStats::LatencyStats() :
+	count(0), sum(0.0), max(0.0)
+{
+	buckets.fill(0);
+}
+
+void LatencyStats::Add(double seconds)
+{
+	int bucket = (int)std::floor((std::log10(std::max(seconds, 1e-12)) - MIN_EXPONENT) * BUCKETS_PER_DECADE);
+	buckets[std::min(std::max(bucket, 0), NUM_BUCKETS - 1)]++;
+
+	count++;
+	sum += seconds;
+	max = std::max(max, seconds);
+}
+
+double LatencyStats::Percentile(double p) const
+{
+	size_t rank = (size_t)std::ceil(p * count);
+	size_t seen = 0;
+	for (int i = 0; i < NUM_BUCKETS; i++)
+	{
+		seen += buckets[i];
+		if (seen >= rank && seen > 0)
+			return std::min(max, std::pow(10.0, MIN_EXPONENT + (double)(i + 1) / BUCKETS_PER_DECADE));
+	}
+
+	return max;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <vector>
+
+/*
+ * The last size samples of a channel. Every sample is stored twice, size
+ * samples apart, so the current frame is always one contiguous piece of memory
+ * that can be transformed without copying it first
+ */
+class SampleRing
+{
+public:
+	SampleRing(size_t size);
+
+	void Push(const double* samples, size_t count);
+
+	// The last size samples, oldest first
+	const double* Frame() const { return data.data() + next; }
+
+private:
+	size_t size, next;
+	std::vector<double> data;
+};
+
+/*
+ * Distribution of latencies, counted in logarithmic buckets so a stream of any
+ * length takes the same memory. Percentiles are accurate to about 12%
+ */
+class LatencyStats
+{
+public:
+	LatencyStats();
+
+	void Add(double seconds);
+
+	size_t Count() const { return count; }
+	double Mean() const { return count ? sum / count : 0.0; }
+	double Max() const { return max; }
+
+	// p in [0, 1], the upper end of the bucket the percentile falls into
+	double Percentile(double p) const;
+
+private:
+	// 1us to 100s
+	static constexpr int BUCKETS_PER_DECADE = 20;
+	static constexpr int MIN_EXPONENT = -6;
+	static constexpr int NUM_BUCKETS = 8 * BUCKETS_PER_DECADE;
+
+	std::array<size_t, NUM_BUCKETS> buckets;
+	size_t count;
+	double sum, max;
+};
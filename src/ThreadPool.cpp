@@ -0,0 +1,203 @@
+#include "ThreadPool.hpp"
+
+// Identifies the pool and the deque of the current thread
+thread_local const ThreadPool* currentPool = nullptr;
+thread_local size_t currentQueue = 0;
+
+std::unique_ptr<ThreadPool> globalPool;
+
+ThreadPool::ThreadPool(unsigned int threads) :
+	queued(0), stop(false)
+{
+	if (threads == 0)
+		threads = 1;
+
+	for (unsigned int i = 0; i < threads; i++)
+		queues.push_back(std::make_unique<Queue>());
+
+	for (unsigned int i = 1; i < threads; i++)
+		workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		stop = true;
+	}
+	sleep.notify_all();
+
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+void ThreadPool::Submit(Task task)
+{
+	Queue& queue = *queues[CurrentQueue()];
+	queued++;
+	{
+		std::unique_lock<std::mutex> lock(queue.mutex);
+		queue.tasks.push_back(std::move(task));
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(sleepMutex);
+	}
+	sleep.notify_one();
+}
+
+bool ThreadPool::RunPendingTask()
+{
+	Task task;
+	size_t index = CurrentQueue();
+	if (!Pop(index, task) && !Steal(index, task))
+		return false;
+
+	task();
+	return true;
+}
+
+void ThreadPool::WaitForWork(const std::function<bool()>& pred)
+{
+	std::unique_lock<std::mutex> lock(sleepMutex);
+	sleep.wait(lock, [&]() { return stop || queued > 0 || pred(); });
+}
+
+void ThreadPool::Notify()
+{
+	{
+		std::unique_lock<std::mutex> lock(sleepMutex);
+	}
+	sleep.notify_all();
+}
+
+void ThreadPool::WorkerLoop(size_t index)
+{
+	currentPool = this;
+	currentQueue = index;
+
+	while (true)
+	{
+		if (RunPendingTask())
+			continue;
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		sleep.wait(lock, [this]() { return stop || queued > 0; });
+		if (stop && queued == 0)
+			break;
+	}
+}
+
+bool ThreadPool::Pop(size_t index, Task& task)
+{
+	Queue& queue = *queues[index];
+	std::unique_lock<std::mutex> lock(queue.mutex);
+	if (queue.tasks.empty())
+		return false;
+
+	// Threads outside the pool share queue 0, it is worked on in FIFO order
+	if (index == 0)
+	{
+		task = std::move(queue.tasks.front());
+		queue.tasks.pop_front();
+	}
+	else
+	{
+		task = std::move(queue.tasks.back());
+		queue.tasks.pop_back();
+	}
+
+	queued--;
+	return true;
+}
+
+bool ThreadPool::Steal(size_t thief, Task& task)
+{
+	for (size_t i = 1; i <= queues.size(); i++)
+	{
+		Queue& queue = *queues[(thief + i) % queues.size()];
+		std::unique_lock<std::mutex> lock(queue.mutex);
+		if (queue.tasks.empty())
+			continue;
+
+		task = std::move(queue.tasks.front());
+		queue.tasks.pop_front();
+		queued--;
+		return true;
+	}
+
+	return false;
+}
+
+size_t ThreadPool::CurrentQueue() const
+{
+	return (currentPool == this) ? currentQueue : 0;
+}
+
+TaskGroup::TaskGroup(ThreadPool& pool) :
+	pool(pool), pending(0)
+{
+}
+
+TaskGroup::~TaskGroup()
+{
+	// Tasks reference the group, so it can't go away before they are done
+	while (pending > 0)
+	{
+		if (!pool.RunPendingTask())
+			pool.WaitForWork([this]() { return pending == 0; });
+	}
+}
+
+void TaskGroup::Run(Task task)
+{
+	pending++;
+	pool.Submit([this, task = std::move(task)]()
+	{
+		try
+		{
+			task();
+		}
+		catch (...)
+		{
+			std::unique_lock<std::mutex> lock(errorMutex);
+			if (!error)
+				error = std::current_exception();
+		}
+
+		// The group may be gone as soon as pending reaches zero
+		ThreadPool& owner = pool;
+		if (--pending == 0)
+			owner.Notify();
+	});
+}
+
+void TaskGroup::Wait()
+{
+	while (pending > 0)
+	{
+		if (!pool.RunPendingTask())
+			pool.WaitForWork([this]() { return pending == 0; });
+	}
+
+	std::unique_lock<std::mutex> lock(errorMutex);
+	if (error)
+	{
+		std::exception_ptr e = error;
+		error = nullptr;
+		std::rethrow_exception(e);
+	}
+}
+
+void CreateThreadPool(unsigned int threads)
+{
+	globalPool = std::make_unique<ThreadPool>(threads);
+}
+
+ThreadPool& GetThreadPool()
+{
+	if (!globalPool)
+		CreateThreadPool(std::thread::hardware_concurrency());
+
+	return *globalPool;
+}
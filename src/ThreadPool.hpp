@@ -0,0 +1,89 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef std::function<void()> Task;
+
+/*
+ * Work-stealing thread pool. Every worker owns a deque, tasks submitted from
+ * a worker go to the back of its own deque and are popped from there again
+ * (depth first, cache friendly), idle workers steal from the front of the
+ * others (the oldest, and usually biggest, tasks). Tasks submitted from
+ * outside the pool go to a shared queue.
+ *
+ * Threads waiting on a TaskGroup keep executing tasks instead of blocking, so
+ * tasks may freely spawn and wait for subtasks at any nesting level without
+ * ever needing more threads than the pool has.
+ */
+class ThreadPool
+{
+public:
+	// threads is the total number of threads that work on tasks. The thread
+	// that waits on the tasks counts as one, so threads - 1 workers are started
+	ThreadPool(unsigned int threads);
+	~ThreadPool();
+
+	void Submit(Task task);
+
+	// Runs one queued task on the calling thread. Returns false if there was none
+	bool RunPendingTask();
+
+	// Blocks until pred() is true or new tasks are available
+	void WaitForWork(const std::function<bool()>& pred);
+
+	// Wakes up all threads blocked in WaitForWork
+	void Notify();
+
+	unsigned int Size() const { return (unsigned int)queues.size(); }
+
+private:
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	void WorkerLoop(size_t index);
+	bool Pop(size_t index, Task& task);
+	bool Steal(size_t thief, Task& task);
+	size_t CurrentQueue() const;
+
+	// queues[0] is shared by all threads outside of the pool
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> workers;
+
+	std::atomic<size_t> queued;
+	std::mutex sleepMutex;
+	std::condition_variable sleep;
+	bool stop;
+};
+
+/*
+ * A set of tasks that can be waited for. Wait() helps executing queued tasks
+ * and rethrows the first exception thrown by any task of the group
+ */
+class TaskGroup
+{
+public:
+	TaskGroup(ThreadPool& pool);
+	~TaskGroup();
+
+	void Run(Task task);
+	void Wait();
+
+private:
+	ThreadPool& pool;
+	std::atomic<size_t> pending;
+	std::mutex errorMutex;
+	std::exception_ptr error;
+};
+
+extern void CreateThreadPool(unsigned int threads);
+extern ThreadPool& GetThreadPool();
@@ -0,0 +1,385 @@
+#include "Writer.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#include "json.hpp"
+
+// Text is collected in a buffer of this size before it goes to the stream
+constexpr size_t BUFFER_SIZE = 1 << 16;
+
+// Enough for any number the JsonWriter writes, including sign and exponent
+constexpr size_t MAX_NUMBER_LENGTH = 32;
+
+// Up to this many significant digits, values are rounded with one
+// multiplication by a power of ten, which is exact enough
+constexpr unsigned int FAST_DIGITS = 9;
+
+constexpr uint64_t POW10[] = {
+	1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull,
+	100000000ull, 1000000000ull, 10000000000ull, 100000000000ull, 1000000000000ull,
+	10000000000000ull, 100000000000000ull, 1000000000000000ull, 10000000000000000ull
+};
+
+// value * 10^e, exact powers of ten are used up to 10^22
+static double ScaleByPow10(double value, int e)
+{
+	static const double EXACT[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	if (e >= 0 && e <= 22)
+		return value * EXACT[e];
+	if (e < 0 && e >= -22)
+		return value / EXACT[-e];
+
+	return value * std::pow(10.0, e);
+}
+
+// Appends value to the buffer in little-endian byte order
+template<typename T>
+void BinaryWriter::Put(T value)
+{
+	uint64_t bytes = 0;
+	if constexpr (std::is_floating_point_v<T>)
+		std::memcpy(&bytes, &value, sizeof(value));
+	else
+		bytes = (uint64_t)value;
+
+	for (size_t i = 0; i < sizeof(T); i++)
+		buffer.push_back((unsigned char)(bytes >> (8 * i)));
+}
+
+JsonWriter::JsonWriter(std::ostream& out, bool legacy, unsigned int digits, const std::vector<double>& frequencies, bool lines) :
+	out(out), legacy(legacy), lines(lines), digits(digits), frequencies(frequencies),
+	channel(0), firstChannel(true), firstFrame(true),
+	buffer(BUFFER_SIZE), used(0)
+{
+	Write("{");
+	if (lines)
+	{
+		WriteFrequencies();
+		Write("}\n");
+	}
+}
+
+void JsonWriter::BeginChannel(unsigned int channel)
+{
+	if (lines)
+	{
+		this->channel = channel;
+		return;
+	}
+
+	if (!firstChannel)
+		Write(",");
+
+	Write("\"channel_");
+	WriteInteger(channel);
+	Write("\":[");
+	firstChannel = false;
+	firstFrame = true;
+}
+
+void JsonWriter::SetLabel(const std::string& name)
+{
+	label = name;
+}
+
+void JsonWriter::WriteFrame(size_t begin, size_t end, const FFTPlan& plan, const double* values)
+{
+	if (lines)
+	{
+		Write("{\"channel\":");
+		WriteInteger(channel);
+		Write(",");
+	}
+	else
+	{
+		if (!firstFrame)
+			Write(",");
+		Write("{");
+	}
+
+	if (!label.empty())
+	{
+		Write("\"stat\":\"");
+		Write(label.c_str());
+		Write("\",");
+	}
+	Write("\"begin\":");
+	WriteInteger(begin);
+	Write(",\"end\":");
+	WriteInteger(end);
+	Write(",\"spectrum\":[");
+	for (size_t i = 0; i < plan.NumBins(); i++)
+	{
+		if (i)
+			Write(",");
+
+		if (legacy)
+		{
+			Write("{\"freq\":");
+			WriteNumber(plan.Frequencies()[i], 0);
+			Write(",\"mag\":");
+			WriteNumber(values[i], digits);
+			Write("}");
+		}
+		else
+		{
+			WriteNumber(values[i], digits);
+		}
+	}
+	Write(lines ? "]}\n" : "]}");
+
+	firstFrame = false;
+}
+
+void JsonWriter::EndChannel()
+{
+	if (!lines)
+		Write("]");
+}
+
+void JsonWriter::Flush()
+{
+	WriteBuffer();
+	out.flush();
+}
+
+void JsonWriter::Finish()
+{
+	if (!lines)
+	{
+		if (!legacy)
+		{
+			if (!firstChannel)
+				Write(",");
+			WriteFrequencies();
+		}
+
+		Write("}\n");
+	}
+
+	Flush();
+}
+
+void JsonWriter::WriteFrequencies()
+{
+	Write("\"freqs\":[");
+	for (size_t i = 0; i < frequencies.size(); i++)
+	{
+		if (i)
+			Write(",");
+		WriteNumber(frequencies[i], 0);
+	}
+	Write("]");
+}
+
+void JsonWriter::Write(const char* text)
+{
+	size_t length = std::strlen(text);
+	std::memcpy(Reserve(length), text, length);
+	used += length;
+}
+
+void JsonWriter::WriteInteger(size_t value)
+{
+	char* first = Reserve(MAX_NUMBER_LENGTH);
+	used = std::to_chars(first, first + MAX_NUMBER_LENGTH, value).ptr - buffer.data();
+}
+
+/*
+ * Same notation as nlohmann::json::dump(). Without a number of digits, the
+ * shortest representation that reads back as the same double is used (Grisu2).
+ * Otherwise the value is rounded to that many significant digits, which is a
+ * lot cheaper for small numbers of digits and makes the file smaller
+ */
+void JsonWriter::WriteNumber(double value, unsigned int digits)
+{
+	char* first = Reserve(MAX_NUMBER_LENGTH);
+	char* last = first + MAX_NUMBER_LENGTH;
+
+	if (!std::isfinite(value))
+	{
+		std::memcpy(first, "null", 4);
+		used += 4;
+		return;
+	}
+
+	// Far out of the range of a spectrum, where 10^e would overflow
+	if (digits == 0 || value == 0.0 || std::fabs(value) < 1e-280 || std::fabs(value) > 1e280)
+	{
+		used = nlohmann::detail::to_chars(first, last, value) - buffer.data();
+		return;
+	}
+
+	char* pos = first;
+	if (value < 0.0)
+	{
+		*pos++ = '-';
+		value = -value;
+	}
+
+	// value ~ mantissa * 10^(exponent - digits + 1), with a mantissa of exactly
+	// digits digits
+	int exponent = 0;
+	uint64_t mantissa = 0;
+	if (digits <= FAST_DIGITS)
+	{
+		// log10 can be off by one close to powers of ten, which is fixed afterwards
+		exponent = (int)std::floor(std::log10(value));
+		mantissa = (uint64_t)std::llround(ScaleByPow10(value, (int)digits - 1 - exponent));
+		if (mantissa >= POW10[digits])
+		{
+			exponent++;
+			mantissa = (uint64_t)std::llround(ScaleByPow10(value, (int)digits - 1 - exponent));
+		}
+		else if (mantissa < POW10[digits - 1])
+		{
+			exponent--;
+			mantissa = (uint64_t)std::llround(ScaleByPow10(value, (int)digits - 1 - exponent));
+		}
+
+		// Rounding up may still carry into another digit (9.99 -> 10.0)
+		if (mantissa >= POW10[digits])
+		{
+			mantissa /= 10;
+			exponent++;
+		}
+	}
+	else
+	{
+		// The scaling isn't exact enough for this many digits, printf rounds correctly
+		char text[MAX_NUMBER_LENGTH];
+		std::snprintf(text, sizeof(text), "%.*e", (int)digits - 1, value);
+
+		const char* c = text;
+		for (; *c != 'e'; c++)
+		{
+			if (*c != '.')
+				mantissa = mantissa * 10 + (uint64_t)(*c - '0');
+		}
+		exponent = std::atoi(c + 1);
+	}
+
+	int decimalExponent = exponent - (int)digits + 1;
+	while (mantissa % 10 == 0)
+	{
+		mantissa /= 10;
+		decimalExponent++;
+	}
+
+	int length = (int)(std::to_chars(pos, last, mantissa).ptr - pos);
+	used = nlohmann::detail::dtoa_impl::format_buffer(pos, length, decimalExponent, -4, std::numeric_limits<double>::digits10) - buffer.data();
+}
+
+char* JsonWriter::Reserve(size_t size)
+{
+	if (buffer.size() - used < size)
+		WriteBuffer();
+
+	return buffer.data() + used;
+}
+
+void JsonWriter::WriteBuffer()
+{
+	out.write(buffer.data(), used);
+	used = 0;
+}
+
+BinaryWriter::BinaryWriter(std::ostream& out, unsigned int sampleRate, unsigned int numChannels,
+	Scales scale, unsigned int bits, const std::vector<double>& frequencies) :
+	out(out), bits(bits), channel(0), fixedRange(false), min(0.0), max(0.0)
+{
+	const char magic[] = "SPEC";
+	buffer.assign(magic, magic + 4);
+	Put<uint16_t>(1);	// Version
+	Put<uint8_t>((uint8_t)scale);
+	Put<uint8_t>((uint8_t)bits);
+	Put<uint32_t>(sampleRate);
+	Put<uint16_t>((uint16_t)numChannels);
+	Put<uint32_t>((uint32_t)frequencies.size());
+	for (double freq : frequencies)
+		Put<double>(freq);
+
+	out.write((const char*)buffer.data(), buffer.size());
+}
+
+void BinaryWriter::SetRange(double min, double max)
+{
+	fixedRange = true;
+	this->min = min;
+	this->max = max;
+}
+
+void BinaryWriter::BeginChannel(unsigned int channel)
+{
+	this->channel = channel;
+}
+
+void BinaryWriter::WriteFrame(size_t begin, size_t end, const FFTPlan& plan, const double* values)
+{
+	size_t numBins = plan.NumBins();
+
+	buffer.clear();
+	Put<uint16_t>((uint16_t)channel);
+	Put<uint64_t>(begin);
+	Put<uint64_t>(end);
+	Put<uint32_t>((uint32_t)numBins);
+
+	if (bits == 0)
+	{
+		for (size_t i = 0; i < numBins; i++)
+			Put<double>(values[i]);
+	}
+	else
+	{
+		double lo = min, hi = max;
+		if (!fixedRange && numBins)
+		{
+			auto range = std::minmax_element(values, values + numBins);
+			lo = *range.first;
+			hi = *range.second;
+		}
+
+		Put<double>(lo);
+		Put<double>(hi);
+
+		// value = lo + q / levels * (hi - lo)
+		double levels = (double)((1u << bits) - 1);
+		double factor = (hi > lo) ? levels / (hi - lo) : 0.0;
+		for (size_t i = 0; i < numBins; i++)
+		{
+			double q = std::round((values[i] - lo) * factor);
+			q = std::min(std::max(q, 0.0), levels);
+
+			if (bits == 8)
+				Put<uint8_t>((uint8_t)q);
+			else
+				Put<uint16_t>((uint16_t)q);
+		}
+	}
+
+	out.write((const char*)buffer.data(), buffer.size());
+}
+
+void BinaryWriter::EndChannel()
+{
+}
+
+void BinaryWriter::Flush()
+{
+	out.flush();
+}
+
+void BinaryWriter::Finish()
+{
+	out.flush();
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "FFT.hpp"
+
+enum class OutputFormats {
+	JSON,
+	NDJSON,
+	BINARY
+};
+
+// Where the min/max of a quantized frame come from
+enum class QuantizeRanges {
+	FILE,
+	FRAME
+};
+
+/*
+ * Writes the spectra of one audio file. Frames have to be passed channel by
+ * channel and in order within a channel, so the output can be written as it
+ * comes in
+ */
+class SpectrumWriter
+{
+public:
+	virtual ~SpectrumWriter() = default;
+
+	virtual void BeginChannel(unsigned int channel) = 0;
+	virtual void WriteFrame(size_t begin, size_t end, const FFTPlan& plan, const double* values) = 0;
+	virtual void EndChannel() = 0;
+
+	// Passes everything written so far on to the stream and flushes it
+	virtual void Flush() = 0;
+
+	// Writes everything that comes after the last channel
+	virtual void Finish() = 0;
+};
+
+/*
+ * The JSON structure described in the README. Written as text into a buffer
+ * that is passed on to the stream in large pieces, instead of building a
+ * document first.
+ *
+ * With lines, every frame is a JSON object on its own line instead (NDJSON),
+ * after a first line with the frequencies. Lines can be read as soon as they
+ * are written, and frames don't have to be grouped by channel
+ */
+class JsonWriter : public SpectrumWriter
+{
+public:
+	// digits is the number of significant digits of the spectrum values, 0
+	// for the shortest representation that reads back as the same double
+	JsonWriter(std::ostream& out, bool legacy, unsigned int digits, const std::vector<double>& frequencies, bool lines = false);
+
+	void BeginChannel(unsigned int channel) override;
+	void WriteFrame(size_t begin, size_t end, const FFTPlan& plan, const double* values) override;
+	void EndChannel() override;
+	void Flush() override;
+	void Finish() override;
+
+	// Names the frames that follow with a "stat" field, none if empty
+	void SetLabel(const std::string& name);
+
+private:
+	void Write(const char* text);
+	void WriteInteger(size_t value);
+	void WriteNumber(double value, unsigned int digits);
+	void WriteFrequencies();
+
+	// Makes room for at least size characters in the buffer
+	char* Reserve(size_t size);
+	void WriteBuffer();
+
+	std::ostream& out;
+	bool legacy, lines;
+	unsigned int digits;
+	const std::vector<double>& frequencies;
+	unsigned int channel;
+	bool firstChannel, firstFrame;
+	std::string label;
+
+	std::vector<char> buffer;
+	size_t used;
+};
+
+/*
+ * Compact little-endian binary format, see the README for the layout. Values
+ * are either stored as doubles or quantized to 8/16 bit, in which case every
+ * frame carries the range it was quantized with
+ */
+class BinaryWriter : public SpectrumWriter
+{
+public:
+	// bits is 0 for unquantized doubles, or 8/16
+	BinaryWriter(std::ostream& out, unsigned int sampleRate, unsigned int numChannels,
+		Scales scale, unsigned int bits, const std::vector<double>& frequencies);
+
+	// Quantize with a fixed range instead of the min/max of each frame
+	void SetRange(double min, double max);
+
+	void BeginChannel(unsigned int channel) override;
+	void WriteFrame(size_t begin, size_t end, const FFTPlan& plan, const double* values) override;
+	void EndChannel() override;
+	void Flush() override;
+	void Finish() override;
+
+private:
+	template<typename T>
+	void Put(T value);
+
+	std::ostream& out;
+	unsigned int bits;
+	unsigned int channel;
+	bool fixedRange;
+	double min, max;
+	std::vector<unsigned char> buffer;
+};
@@ -3,13 +3,49 @@
 #include <iomanip>
 #include <map>
 #include <filesystem>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <limits>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <memory>
+#include <chrono>
+#include <functional>
 
-#include "AudioFile.h"
-#include "json.hpp"
 #include "cxxopts.hpp"
 #include "FFT.hpp"
+#include "ThreadPool.hpp"
+#include "Writer.hpp"
+#include "Image.hpp"
+#include "Deflate.hpp"
+#include "AudioStream.hpp"
+#include "MemoryBudget.hpp"
+#include "Stream.hpp"
+#include "Statistics.hpp"
 
-#define PRINTER(s, x) if(!s.quiet) { std::cout << x; }
+#define PRINTER(s, x) if(!s.quiet) { std::lock_guard<std::mutex> lock(printMutex); std::cout << x; }
+
+// Consecutive frames of one channel that are transformed by the same task
+constexpr size_t FRAMES_PER_TASK = 16;
+
+// Memory set aside for the buffers of the output writer and its file
+constexpr size_t WRITER_MEMORY = 256 * 1024;
+
+constexpr size_t MEGABYTE = 1024 * 1024;
+
+// Most samples per channel that --stream reads at once
+constexpr size_t STREAM_READ_BLOCK = 4096;
+
+// Samples per channel that --psd and --stats read at once, unless the budget
+// is smaller
+constexpr size_t PSD_BLOCK_SAMPLES = (size_t)1 << 20;
+
+// Bins of one channel whose statistics are updated by the same task
+constexpr size_t BINS_PER_TASK = 64;
+
+std::mutex printMutex;
 
 const std::map<std::string, WindowFunctions> FUNCTIONS {
 	{"rectangle", WindowFunctions::RECTANGLE},
@@ -19,19 +55,139 @@ const std::map<std::string, WindowFunctions> FUNCTIONS {
 	{"blackman", WindowFunctions::BLACKMAN}
 };
 
+const std::map<std::string, FFTEngines> ENGINES {
+	{"auto", FFTEngines::AUTO},
+	{"radix2", FFTEngines::RADIX2},
+	{"split-radix", FFTEngines::SPLIT_RADIX},
+	{"four-step", FFTEngines::FOUR_STEP}
+};
+
+const std::map<std::string, Scales> SCALES {
+	{"linear", Scales::LINEAR},
+	{"power", Scales::POWER},
+	{"db", Scales::DECIBEL}
+};
+
+const std::map<std::string, OutputFormats> FORMATS {
+	{"json", OutputFormats::JSON},
+	{"ndjson", OutputFormats::NDJSON},
+	{"binary", OutputFormats::BINARY}
+};
+
+const std::map<std::string, ImageFormats> IMAGE_FORMATS {
+	{"png", ImageFormats::PNG},
+	{"ppm", ImageFormats::PPM},
+	{"pgm", ImageFormats::PGM}
+};
+
+const std::map<std::string, Colormaps> COLORMAPS {
+	{"viridis", Colormaps::VIRIDIS},
+	{"gray", Colormaps::GRAY}
+};
+
+// Sample formats of headerless input, and whether they are big-endian
+const std::map<std::string, std::pair<SampleFormats, bool>> RAW_FORMATS {
+	{"u8", {SampleFormats::UINT8, false}},
+	{"s8", {SampleFormats::INT8, false}},
+	{"s16le", {SampleFormats::INT16, false}},
+	{"s16be", {SampleFormats::INT16, true}},
+	{"s24le", {SampleFormats::INT24, false}},
+	{"s24be", {SampleFormats::INT24, true}},
+	{"s32le", {SampleFormats::INT32, false}},
+	{"s32be", {SampleFormats::INT32, true}},
+	{"f32le", {SampleFormats::FLOAT32, false}},
+	{"f32be", {SampleFormats::FLOAT32, true}},
+	{"f64le", {SampleFormats::FLOAT64, false}},
+	{"f64be", {SampleFormats::FLOAT64, true}}
+};
+
+const std::map<std::string, QuantizeRanges> QUANTIZE_RANGES {
+	{"file", QuantizeRanges::FILE},
+	{"frame", QuantizeRanges::FRAME}
+};
+
+const std::map<std::string, PSDMethods> PSD_METHODS {
+	{"welch", PSDMethods::WELCH}
+};
+
+// A point in a file, either in seconds or in samples
+struct Position {
+	double value;
+	bool samples;
+};
+
 struct Settings {
 	std::vector<std::filesystem::path> files;
 	bool quiet;
 	float splitInterval;
 	double minFreq, maxFreq;
+	std::vector<double> bins;
 	unsigned int analyzeChannel;
 	unsigned int zeropadding;
 	bool approx, legacy;
+	bool decimate;
 	WindowFunctions window;
+	FFTEngines engine;
+	Scales scale;
+	double dbFloor;
+	OutputFormats format;
+	unsigned int quantize;
+	QuantizeRanges quantizeRange;
+	bool image;
+	ImageFormats imageFormat;
+	unsigned int imageWidth, imageHeight;
+	Colormaps colormap;
+	bool gzip;
+	unsigned int precisionDigits;
+	size_t maxMemory;
+	bool hasStart, hasEnd;
+	Position start, end;
+	bool raw;
+	SampleFormats rawFormat;
+	bool rawBigEndian;
+	unsigned int rawRate, rawChannels;
+	bool stream;
+	bool hasHop;
+	Position hop;
+	bool reportLatency;
+	PSDMethods psd;
+	std::vector<Stat> stats;
+	bool labelStats;
+	unsigned int threads;
 };
 
 Settings Parse(int argc, char** argv);
 
+// A file whose header has been read and whose memory is reserved
+struct Job {
+	// "-" for stdin, which is kept open since it can't be opened again
+	std::filesystem::path file;
+	std::unique_ptr<AudioStream> stdinAudio;
+	int sampleRate;
+
+	// Range of samples that is analyzed
+	size_t firstSample;
+	size_t numSamples;
+
+	// Channels that are analyzed, starting at 1
+	std::vector<int> channels;
+	size_t sampleInterval, numFrames, lastLength;
+
+	// Distance between the starts of two frames. Only --psd frames overlap
+	size_t hop;
+
+	// Whether all channels are analyzed at once, or one channel after the
+	// other in batches of batchFrames frames
+	bool allChannels;
+	size_t batchFrames;
+
+	std::unique_ptr<MemoryReservation> reservation;
+};
+
+std::shared_ptr<Job> Prepare(const Settings& setts, MemoryBudget& budget, const std::filesystem::path& file);
+void Analyze(const Settings& setts, Job& job);
+void AnalyzeStream(const Settings& setts);
+
 int main(int argc, char** argv)
 {
 	Settings setts;
@@ -39,104 +195,940 @@ int main(int argc, char** argv)
 
 	if (setts.approx) 
 		UseFastFunctions();
+	if (setts.decimate)
+		UseDecimation();
+
+	SetWindowFunction(setts.window);
+	SetEngine(setts.engine);
+	// --psd and --stats summarize power, which is only turned into the
+	// output scale at the end
+	SetScale(setts.stats.empty() ? setts.scale : Scales::POWER, setts.dbFloor);
+	CreateThreadPool(setts.threads);
 
-	std::function<void(nlohmann::json&, const std::vector<std::pair<double, double>>&)> toJson;
-	if (setts.legacy)
+	if (setts.stream)
 	{
-		toJson = [](nlohmann::json& target, const std::vector<std::pair<double, double>>& spectrum)
+		AnalyzeStream(setts);
+		return 0;
+	}
+
+	MemoryBudget budget(GetThreadPool(), setts.maxMemory);
+
+	// Files, channels and batches of frames are all tasks on the same pool,
+	// so a long file keeps every thread busy even when the others are done.
+	// Memory is reserved here, before a file is started, so a task never
+	// waits for memory while holding some itself
+	TaskGroup files(GetThreadPool());
+	for (auto& file : setts.files) {
+		std::shared_ptr<Job> job = Prepare(setts, budget, file);
+		if (!job)
+			continue;
+
+		files.Run([&setts, job]()
 		{
-			target.push_back({ "spectrum", nlohmann::json::array()});
+			Analyze(setts, *job);
+			job->reservation.reset();
+		});
+	}
+	files.Wait();
 
-			for (const std::pair<double, double>& pair : spectrum) {
-				target["spectrum"].push_back({{"freq", pair.first}, {"mag", pair.second}});
-			}
-		};
+	return 0;
+}
+
+std::string OutputExtension(const Settings& setts)
+{
+	std::string extension = (setts.format == OutputFormats::BINARY) ? "spec" : (setts.format == OutputFormats::NDJSON) ? "ndjson" : "json";
+	if (setts.gzip)
+		extension += ".gz";
+	return extension;
+}
+
+bool OpenInput(const Settings& setts, std::istream& in, AudioStream& audio)
+{
+	if (setts.raw)
+		return audio.OpenRaw(in, setts.rawFormat, setts.rawBigEndian, setts.rawRate, setts.rawChannels);
+	return audio.Open(in);
+}
+
+std::shared_ptr<Job> Prepare(const Settings& setts, MemoryBudget& budget, const std::filesystem::path& file)
+{
+	auto job = std::make_shared<Job>();
+	job->file = file;
+
+	bool isStdin = (file == "-");
+	std::string filename = isStdin ? "stdin" : file.filename().string();
+
+	// Only the header is read here, the samples are read by Analyze()
+	std::ifstream input;
+	AudioStream fileAudio;
+	if (isStdin)
+		job->stdinAudio = std::make_unique<AudioStream>();
+	else
+		input.open(file, std::ios::binary);
+
+	std::istream& in = isStdin ? std::cin : input;
+	AudioStream& audio = isStdin ? *job->stdinAudio : fileAudio;
+	bool opened = (bool)in;
+	if (!opened || !OpenInput(setts, in, audio))
+	{
+		std::lock_guard<std::mutex> lock(printMutex);
+		std::cerr << filename << ": " << (opened ? audio.Error() : "can't open file") << std::endl;
+		return nullptr;
+	}
+
+	job->sampleRate = audio.SampleRate();
+
+	// Only the part between --start and --end is read
+	auto toSample = [&](const Position& position)
+	{
+		double sample = position.samples ? position.value : std::round(position.value * job->sampleRate);
+		return (size_t)std::min(sample, (double)audio.NumSamples());
+	};
+	job->firstSample = setts.hasStart ? toSample(setts.start) : 0;
+	size_t endSample = setts.hasEnd ? toSample(setts.end) : audio.NumSamples();
+
+	// A pipe can only be read once, but the samples may be needed several
+	// times and its length has to be known up front, so it is kept in memory
+	if (!audio.Seekable())
+	{
+		if (!audio.Seek(job->firstSample) || !audio.Buffer(endSample - job->firstSample, budget.Limit()))
+		{
+			std::lock_guard<std::mutex> lock(printMutex);
+			std::cerr << filename << ": " << audio.Error() << std::endl;
+			return nullptr;
+		}
+		endSample = std::min(endSample, audio.NumSamples());
+	}
+	if (endSample <= job->firstSample)
+	{
+		std::lock_guard<std::mutex> lock(printMutex);
+		std::cerr << filename << ((setts.hasStart || setts.hasEnd) ? " has no samples between start and end" : " has no samples to analyze") << std::endl;
+		return nullptr;
+	}
+	job->numSamples = endSample - job->firstSample;
+
+	int numChannels = audio.NumChannels();
+	if (setts.analyzeChannel > (unsigned int)numChannels)
+	{
+		std::lock_guard<std::mutex> lock(printMutex);
+		std::cerr << filename << " only has " << numChannels << " channel(s)" << std::endl;
+		return nullptr;
+	}
+
+	if (setts.analyzeChannel != 0)
+	{
+		job->channels.push_back(setts.analyzeChannel);
 	}
 	else
 	{
-		toJson = [](nlohmann::json& target, const std::vector<std::pair<double, double>>& spectrum)
+		for (int c = 1; c <= numChannels; c++)
+			job->channels.push_back(c);
+	}
+	size_t numAnalyzed = job->channels.size();
+
+	if (!setts.bins.empty() && *std::max_element(setts.bins.begin(), setts.bins.end()) > job->sampleRate / 2.0)
+	{
+		std::lock_guard<std::mutex> lock(printMutex);
+		std::cerr << filename << " has a sample rate of " << job->sampleRate << "Hz, bins above " << job->sampleRate / 2.0 << "Hz can't be analyzed" << std::endl;
+		return nullptr;
+	}
+
+	job->sampleInterval = (setts.splitInterval > 0.0f ? (size_t)(job->sampleRate * setts.splitInterval / 1000) : job->numSamples);
+	if (job->sampleInterval == 0)
+	{
+		std::lock_guard<std::mutex> lock(printMutex);
+		std::cerr << filename << " has no samples to analyze" << std::endl;
+		return nullptr;
+	}
+
+	// Files can be as long as they like, but window and transform of a frame
+	// are indexed with unsigned int
+	const size_t maxFrame = std::numeric_limits<unsigned int>::max();
+	if (job->sampleInterval > maxFrame || FFTPlan::PaddedSize(std::min(job->sampleInterval, job->numSamples), setts.zeropadding) > maxFrame)
+	{
+		std::lock_guard<std::mutex> lock(printMutex);
+		std::cerr << filename << ": frames of " << job->sampleInterval << " samples are too long to transform, use a shorter -i" << std::endl;
+		return nullptr;
+	}
+
+	job->numFrames = (job->numSamples + job->sampleInterval - 1) / job->sampleInterval;
+	job->lastLength = job->numSamples - (job->numFrames - 1) * job->sampleInterval;
+	job->hop = job->sampleInterval;
+
+	// Welch's frames overlap by half unless --hop says otherwise, and only
+	// whole frames are summarized
+	if (!setts.stats.empty())
+	{
+		job->sampleInterval = std::min(job->sampleInterval, job->numSamples);
+		size_t defaultHop = (setts.psd != PSDMethods::NONE) ? std::max<size_t>(job->sampleInterval / 2, 1) : job->sampleInterval;
+		job->hop = setts.hasHop ? toSample(setts.hop) : defaultHop;
+		if (job->hop == 0 || job->hop > job->sampleInterval)
+		{
+			std::lock_guard<std::mutex> lock(printMutex);
+			std::cerr << filename << ": the hop has to be between one sample and the frame length" << std::endl;
+			return nullptr;
+		}
+
+		job->numFrames = (job->numSamples - job->sampleInterval) / job->hop + 1;
+		job->lastLength = job->sampleInterval;
+	}
+
+	// Everything that doesn't depend on how many frames are in memory at once.
+	// Every task of FRAMES_PER_TASK frames uses a workspace of the plan, so no
+	// more of them than there are tasks at the same time are busy, whatever the
+	// size of the pool
+	size_t maxBins = setts.bins.empty() ? FFTPlan::PaddedSize(job->sampleInterval, setts.zeropadding) / 2 + 1 : setts.bins.size();
+	size_t channelTasks = (job->numFrames + FRAMES_PER_TASK - 1) / FRAMES_PER_TASK;
+	size_t busyThreads = std::min<size_t>(GetThreadPool().Size(), numAnalyzed * channelTasks);
+	const size_t workspace = FFTPlan::WorkspaceMemory(job->sampleInterval, setts.zeropadding);
+	size_t fixedMemory = 2 * FFTPlan::Memory(job->sampleInterval, job->sampleInterval, setts.zeropadding)
+		+ audio.Memory() + WRITER_MEMORY + maxBins * sizeof(double);
+	if (setts.gzip)
+		fixedMemory += DeflateStream::Memory();
+	if (setts.image)
+		fixedMemory += ImageWriter::Memory(setts.imageWidth, setts.imageHeight, numAnalyzed, job->numFrames, maxBins);
+
+	// If the whole file fits into the budget, all channels are decoded and
+	// transformed at once. Otherwise the file is read once per channel, a
+	// batch of frames at a time, and every batch is written before the
+	// next one is read. Only the analyzed channels are decoded
+	const size_t frameSamples = (size_t)job->sampleInterval * sizeof(double);
+	const size_t frameSpectrum = maxBins * sizeof(double);
+
+	// Summaries only keep sums and statistics: all channels are read at once,
+	// a block of frames at a time. A block holds hop new samples per frame
+	// plus the overlap with the next block, every task of it a partial sum,
+	// and the spectra of all its frames if there are statistics besides the mean
+	if (!setts.stats.empty())
+	{
+		bool keepSpectra = false, percentiles = false;
+		for (const Stat& stat : setts.stats)
 		{
-			target.push_back({ "spectrum", nlohmann::json::array() });
+			keepSpectra |= (stat.type != StatTypes::MEAN);
+			percentiles |= (stat.type == StatTypes::PERCENTILE);
+		}
 
-			for (const std::pair<double, double>& pair : spectrum) {
-				target["spectrum"].push_back(pair.second);
+		size_t blockMemory = fixedMemory + busyThreads * (workspace + frameSpectrum)
+			+ numAnalyzed * ((size_t)(job->sampleInterval - job->hop) * sizeof(double) + (setts.stats.size() + 2) * frameSpectrum);
+		if (keepSpectra)
+			blockMemory += numAnalyzed * SpectrumStats::Memory(maxBins, setts.dbFloor, percentiles);
+		size_t perFrame = numAnalyzed * ((size_t)job->hop * sizeof(double) + frameSpectrum / FRAMES_PER_TASK + (keepSpectra ? frameSpectrum : 0));
+
+		// Blocks are made of whole tasks, so the frames are summed in the same
+		// order whatever the block size is
+		size_t minFrames = std::min<size_t>(job->numFrames, FRAMES_PER_TASK);
+		size_t batch = std::max<size_t>(PSD_BLOCK_SAMPLES / job->hop, FRAMES_PER_TASK);
+		if (budget.Limit() != 0)
+		{
+			if (blockMemory + minFrames * perFrame > budget.Limit())
+			{
+				std::lock_guard<std::mutex> lock(printMutex);
+				std::cerr << filename << " needs at least " << (blockMemory + minFrames * perFrame + MEGABYTE - 1) / MEGABYTE << "MB of memory with these settings" << std::endl;
+				return nullptr;
 			}
-		};
+			batch = std::min(batch, (budget.Limit() - blockMemory) / perFrame);
+		}
+		batch = std::min<size_t>(job->numFrames, std::max(batch / FRAMES_PER_TASK * FRAMES_PER_TASK, minFrames));
+
+		job->allChannels = true;
+		job->batchFrames = batch;
+		job->reservation = std::make_unique<MemoryReservation>(budget, blockMemory + batch * perFrame);
+		return job;
 	}
 
-	int numFiles = setts.files.size();
-	for (auto& file : setts.files) {
-		AudioFile<double> audioFile;
+	// The last frame has a plan and a workspace of its own
+	if (job->numFrames > 1)
+		fixedMemory += FFTPlan::WorkspaceMemory(job->lastLength, setts.zeropadding);
+	size_t memory = fixedMemory + busyThreads * workspace + (size_t)job->numFrames * numAnalyzed * (frameSamples + frameSpectrum);
 
-		if (!audioFile.load(file.string()))
+	job->allChannels = (budget.Limit() == 0 || memory <= budget.Limit());
+	job->batchFrames = job->numFrames;
+	if (!job->allChannels)
+	{
+		// The channels take turns, so the workspaces of one are enough
+		fixedMemory += std::min<size_t>(GetThreadPool().Size(), channelTasks) * workspace;
+		size_t minimum = fixedMemory + frameSamples + frameSpectrum;
+		if (minimum > budget.Limit())
 		{
-			continue;
+			std::lock_guard<std::mutex> lock(printMutex);
+			std::cerr << filename << " needs at least " << (minimum + MEGABYTE - 1) / MEGABYTE << "MB of memory with these settings" << std::endl;
+			return nullptr;
 		}
 
-		std::string filename = file.filename().string();
+		job->batchFrames = std::min<size_t>(job->numFrames, (budget.Limit() - fixedMemory) / (frameSamples + frameSpectrum));
+		memory = fixedMemory + job->batchFrames * (frameSamples + frameSpectrum);
+	}
 
-		int sampleRate = audioFile.getSampleRate();
-		int numChannels = audioFile.getNumChannels();
+	// Waits until other files are done if there isn't enough memory left
+	job->reservation = std::make_unique<MemoryReservation>(budget, memory);
+	return job;
+}
 
-		nlohmann::json output;
-		if(!setts.legacy)
-			output["freqs"] = nlohmann::json::array();
+// The spectra --psd and --stats write for every analyzed channel: one per
+// statistic, back to back, in the output scale.
+//
+// The mean is Welch's method: the frames of a block are split into tasks
+// that each sum their own frames, and the partial sums are merged in a fixed
+// order. Blocks are whole tasks, so every task covers the same frames
+// whatever the block size is, and the result depends neither on which thread
+// did what nor on the memory budget. For the
+// other statistics the power spectra of a block are kept until the
+// SpectrumStats of each channel has been updated, again in parallel, by
+// tasks that each take a range of bins
+std::vector<std::vector<double>> SummarizeSpectra(const Settings& setts, Job& job, AudioStream& audio, const FFTPlan& plan, const std::string& filename)
+{
+	const size_t frameSize = job.sampleInterval;
+	const size_t hop = job.hop;
+	const size_t numFrames = job.numFrames;
+	const size_t numChannels = job.channels.size();
+	const size_t numBins = plan.NumBins();
 
-		int c = setts.analyzeChannel;
-		if (c == 0)
-			c = 1;
-		else
-			numChannels = c;
-
-		for (int c = 1; c <= numChannels; c++) {
-			PRINTER(setts, "\rAnalyzing " << filename << "... Channel " << c << "/" << numChannels << " 0%                  ");
-
-			std::string chName = "channel_" + std::to_string(c);
-			output[chName] = nlohmann::json::array();
-
-			int sampleInterval = (setts.splitInterval > 0.0f ? sampleRate * setts.splitInterval / 1000 : audioFile.samples[c - 1].size());
-			SetWindowFunction(setts.window, sampleInterval);
-			int currentSample;
-			for (currentSample = 0; currentSample < audioFile.samples[c - 1].size(); currentSample += sampleInterval)
-			{
-				std::vector<std::pair<double, double>> spectrum = 
-					FFT(
-						audioFile.samples[c - 1].cbegin() + currentSample,
-						std::min(
-							audioFile.samples[c - 1].cbegin() + currentSample + sampleInterval,
-							audioFile.samples[c - 1].cend()
-						),
-						sampleRate,
-						setts.minFreq, setts.maxFreq,
-						setts.zeropadding
-					);
-
-				if (!setts.legacy && output["freqs"].empty())
+	bool keepSpectra = false, percentiles = false;
+	for (const Stat& stat : setts.stats)
+	{
+		keepSpectra |= (stat.type != StatTypes::MEAN);
+		percentiles |= (stat.type == StatTypes::PERCENTILE);
+	}
+
+	std::vector<unsigned int> selected;
+	for (int c : job.channels)
+		selected.push_back(c - 1);
+	audio.SelectChannels(selected);
+	audio.Seek(job.firstSample);
+
+	std::vector<PowerAverage> averages(numChannels, PowerAverage(numBins));
+	std::vector<SpectrumStats> stats;
+	if (keepSpectra)
+		stats.resize(numChannels, SpectrumStats(numBins, setts.dbFloor, percentiles));
+
+	std::vector<PowerAverage> partials;
+	std::vector<std::vector<double>> samples;
+	std::vector<std::vector<double>> block(numChannels);
+	std::vector<std::vector<double>> spectra(numChannels);
+
+	std::atomic<size_t> framesDone(0);
+	std::atomic<int> lastPercent(0);
+	PRINTER(setts, "\rAnalyzing " << filename << "... 0%                  ");
+
+	for (size_t firstFrame = 0; firstFrame < numFrames; firstFrame += job.batchFrames)
+	{
+		// The samples this block shares with the last one are still there
+		size_t count = std::min<size_t>(job.batchFrames, numFrames - firstFrame);
+		size_t needed = (count - 1) * hop + frameSize;
+		audio.Read(needed - block[0].size(), samples);
+		for (size_t i = 0; i < numChannels; i++)
+		{
+			block[i].insert(block[i].end(), samples[i].begin(), samples[i].end());
+			if (keepSpectra)
+				spectra[i].resize(count * numBins);
+		}
+
+		size_t numTasks = (count + FRAMES_PER_TASK - 1) / FRAMES_PER_TASK;
+		partials.assign(numChannels * numTasks, PowerAverage(numBins));
+
+		TaskGroup frames(GetThreadPool());
+		for (size_t i = 0; i < numChannels; i++)
+		{
+			for (size_t task = 0; task < numTasks; task++)
+			{
+				frames.Run([&, i, task]()
 				{
-					for (const std::pair<double, double>& pair : spectrum) {
-						output["freqs"].push_back(pair.first);
+					std::vector<double> power;
+					if (!keepSpectra)
+						power.resize(numBins);
+
+					size_t lastFrame = std::min((task + 1) * FRAMES_PER_TASK, count);
+					for (size_t frame = task * FRAMES_PER_TASK; frame < lastFrame; frame++)
+					{
+						double* output = keepSpectra ? spectra[i].data() + frame * numBins : power.data();
+						plan.Execute(block[i].data() + frame * hop, frameSize, output);
+						partials[i * numTasks + task].Add(output);
 					}
+
+					size_t done = (framesDone += lastFrame - task * FRAMES_PER_TASK);
+					int percent = (int)std::floor((float)done / (float)(numFrames * numChannels) * 100.0f);
+					if (lastPercent.exchange(percent) != percent)
+					{
+						PRINTER(setts, "\rAnalyzing " << filename << "... " << percent << "%                  ");
+					}
+				});
+			}
+		}
+		frames.Wait();
+
+		if (keepSpectra)
+		{
+			TaskGroup bins(GetThreadPool());
+			for (size_t i = 0; i < numChannels; i++)
+			{
+				for (size_t first = 0; first < numBins; first += BINS_PER_TASK)
+				{
+					bins.Run([&, i, first]()
+					{
+						stats[i].Add(spectra[i].data(), count, numBins, first, std::min(first + BINS_PER_TASK, numBins));
+					});
 				}
+			}
+			bins.Wait();
+		}
+
+		for (size_t i = 0; i < numChannels; i++)
+		{
+			for (size_t task = 0; task < numTasks; task++)
+				averages[i].Merge(partials[i * numTasks + task]);
+
+			// Keep what the frames of the next block start with
+			size_t consumed = std::min(count * hop, block[i].size());
+			block[i].erase(block[i].begin(), block[i].begin() + consumed);
+		}
+	}
+
+	std::vector<std::vector<double>> results(numChannels, std::vector<double>(setts.stats.size() * numBins));
+	for (size_t i = 0; i < numChannels; i++)
+	{
+		for (size_t k = 0; k < setts.stats.size(); k++)
+		{
+			double* output = results[i].data() + k * numBins;
+			switch (setts.stats[k].type)
+			{
+			case StatTypes::MIN:		stats[i].Min(output); break;
+			case StatTypes::MAX:		stats[i].Max(output); break;
+			case StatTypes::MEAN:		averages[i].Mean(output); break;
+			case StatTypes::PERCENTILE:	stats[i].Percentile(setts.stats[k].percentile, output); break;
+			}
+		}
+		ScalePower(results[i].data(), results[i].size(), setts.scale, setts.dbFloor);
+	}
+	return results;
+}
+
+void Analyze(const Settings& setts, Job& job)
+{
+	std::filesystem::path file = job.file;
+	bool isStdin = (file == "-");
+	std::string filename = isStdin ? "stdin" : file.filename().string();
+
+	// Files are opened again, so that only the files that are being worked
+	// on are open
+	std::ifstream input;
+	AudioStream fileAudio;
+	if (!isStdin)
+	{
+		input.open(file, std::ios::binary);
+		bool opened = (bool)input;
+		if (!opened || !OpenInput(setts, input, fileAudio))
+		{
+			std::lock_guard<std::mutex> lock(printMutex);
+			std::cerr << filename << ": " << (opened ? fileAudio.Error() : "can't open file") << std::endl;
+			return;
+		}
+	}
+	AudioStream& audio = isStdin ? *job.stdinAudio : fileAudio;
+
+	const size_t sampleInterval = job.sampleInterval;
+	const size_t numFrames = job.numFrames;
+	const size_t numChannels = job.channels.size();
+
+	// All frames but the last one have the same length. If the last one
+	// is shorter, it may be padded to a different size and needs its own plan
+	FFTPlan plan(sampleInterval, sampleInterval, job.sampleRate, setts.minFreq, setts.maxFreq, setts.zeropadding, setts.bins);
+	FFTPlan lastPlan(job.lastLength, sampleInterval, job.sampleRate, setts.minFreq, setts.maxFreq, setts.zeropadding, setts.bins);
+
+	// Channels that are analyzed by one read of the file
+	std::vector<std::vector<int>> passes;
+	for (int c : job.channels)
+	{
+		if (passes.empty() || !job.allChannels)
+			passes.emplace_back();
+		passes.back().push_back(c);
+	}
+
+	// The range of quantized values over the whole file has to be known
+	// before the first frame is written, which takes an extra pass if
+	// the spectra don't all fit into memory
+	bool fileRange = (setts.format == OutputFormats::BINARY && setts.quantize && setts.quantizeRange == QuantizeRanges::FILE);
+	bool rangePass = fileRange && !job.allChannels;
+
+	// The frequency axis is the same for every frame, so it is only written once
+	const std::vector<double>& freqs = (numFrames > 1 || job.lastLength == sampleInterval) ? plan.Frequencies() : lastPlan.Frequencies();
+
+	// The results of stdin go to stdout. With compression the writers go
+	// through a DeflateStream, which compresses on its own thread while the
+	// spectra are being serialized
+	std::ofstream ofs;
+	if (!isStdin)
+		ofs.open(file.replace_extension(OutputExtension(setts)), std::ios::binary);
+	std::ostream& target = isStdin ? std::cout : static_cast<std::ostream&>(ofs);
+	std::unique_ptr<DeflateStream> compressed;
+	if (setts.gzip)
+		compressed = std::make_unique<DeflateStream>(target, Containers::GZIP);
+	std::ostream& out = compressed ? *compressed : target;
+
+	std::unique_ptr<SpectrumWriter> writer;
+	BinaryWriter* binary = nullptr;
+	JsonWriter* json = nullptr;
+	if (setts.format == OutputFormats::BINARY)
+	{
+		auto binaryWriter = std::make_unique<BinaryWriter>(out, job.sampleRate, numChannels, setts.scale, setts.quantize, freqs);
+		binary = binaryWriter.get();
+		writer = std::move(binaryWriter);
+	}
+	else
+	{
+		auto jsonWriter = std::make_unique<JsonWriter>(out, setts.legacy, setts.precisionDigits, freqs, setts.format == OutputFormats::NDJSON);
+		json = jsonWriter.get();
+		writer = std::move(jsonWriter);
+	}
+
+	std::vector<SpectrumWriter*> writers = { writer.get() };
+
+	std::ofstream imageOfs;
+	std::unique_ptr<ImageWriter> image;
+	if (setts.image)
+	{
+		const char* extension = (setts.imageFormat == ImageFormats::PNG) ? "png" : (setts.imageFormat == ImageFormats::PPM) ? "ppm" : "pgm";
+		imageOfs.open(file.replace_extension(extension), std::ios::binary);
+		image = std::make_unique<ImageWriter>(imageOfs, setts.imageFormat, setts.colormap, setts.imageWidth, setts.imageHeight,
+			numChannels, numFrames, plan.NumBins(), setts.scale, setts.dbFloor);
+		writers.push_back(image.get());
+	}
+
+	// Spectra are collected in one flat buffer per channel of a pass, frame
+	// after frame, and written out in order once every frame of a batch is done
+	size_t stride = std::max(plan.NumBins(), lastPlan.NumBins());
+	std::vector<std::vector<double>> samples;
+	std::vector<std::vector<double>> spectra(passes[0].size());
+
+	size_t totalFrames = (size_t)numFrames * numChannels * (rangePass ? 2 : 1);
+	std::atomic<size_t> framesDone(0);
+	std::atomic<int> lastPercent(0);
+	PRINTER(setts, "\rAnalyzing " << filename << "... 0%                  ");
+
+	// Reads the frames [firstFrame, firstFrame + count) and transforms them for
+	// every channel of the pass
+	auto transform = [&](const std::vector<int>& channels, size_t firstFrame, size_t count)
+	{
+		size_t firstSample = firstFrame * sampleInterval;
+		audio.Read(std::min(count * sampleInterval, job.numSamples - firstSample), samples);
+
+		TaskGroup frames(GetThreadPool());
+		for (size_t i = 0; i < channels.size(); i++) {
+			const std::vector<double>& channelSamples = samples[i];
+
+			std::vector<double>& channel = spectra[i];
+			channel.resize(stride * count);
+
+			for (size_t taskFrame = 0; taskFrame < count; taskFrame += FRAMES_PER_TASK)
+			{
+				frames.Run([&, taskFrame]()
+				{
+					size_t lastFrame = std::min(taskFrame + FRAMES_PER_TASK, count);
+					for (size_t frame = taskFrame; frame < lastFrame; frame++)
+					{
+						const FFTPlan& framePlan = (firstFrame + frame == numFrames - 1) ? lastPlan : plan;
+						framePlan.Execute(channelSamples.data() + frame * sampleInterval, framePlan.FrameSize(), channel.data() + frame * stride);
+					}
 
-				output[chName].push_back({
-					{"begin", currentSample},
-					{"end", currentSample + sampleInterval}
+					size_t done = (framesDone += lastFrame - taskFrame);
+					int percent = (int)std::floor((float)done / (float)totalFrames * 100.0f);
+					if (lastPercent.exchange(percent) != percent)
+					{
+						PRINTER(setts, "\rAnalyzing " << filename << "... " << percent << "%                  ");
+					}
 				});
+			}
+		}
+		frames.Wait();
+	};
+
+	// Transforms every batch of every pass and hands them to process in order
+	auto forEachBatch = [&](const std::function<void(const std::vector<int>&, size_t, size_t)>& process)
+	{
+		for (const std::vector<int>& channels : passes)
+		{
+			std::vector<unsigned int> selected;
+			for (int c : channels)
+				selected.push_back(c - 1);
+			audio.SelectChannels(selected);
+			audio.Seek(job.firstSample);
+			for (size_t firstFrame = 0; firstFrame < numFrames; firstFrame += job.batchFrames)
+			{
+				size_t count = std::min(job.batchFrames, numFrames - firstFrame);
+				transform(channels, firstFrame, count);
+				process(channels, firstFrame, count);
+			}
+		}
+	};
+
+	double min = std::numeric_limits<double>::infinity();
+	double max = -min;
+	auto updateRange = [&](const std::vector<int>& channels, size_t firstFrame, size_t count)
+	{
+		for (size_t i = 0; i < channels.size(); i++) {
+			for (size_t frame = 0; frame < count; frame++) {
+				const FFTPlan& framePlan = (firstFrame + frame == numFrames - 1) ? lastPlan : plan;
+				const double* values = spectra[i].data() + frame * stride;
+				auto range = std::minmax_element(values, values + framePlan.NumBins());
+				if (range.first != values + framePlan.NumBins())
+				{
+					min = std::min(min, *range.first);
+					max = std::max(max, *range.second);
+				}
+			}
+		}
+	};
+
+	auto write = [&](const std::vector<int>& channels, size_t firstFrame, size_t count)
+	{
+		if (fileRange && !rangePass)
+			updateRange(channels, firstFrame, count);
+		if (fileRange && channels[0] == job.channels[0] && firstFrame == 0 && min <= max)
+			binary->SetRange(min, max);
+
+		for (size_t i = 0; i < channels.size(); i++)
+		{
+			if (firstFrame == 0)
+			{
+				for (SpectrumWriter* w : writers)
+					w->BeginChannel(channels[i]);
+			}
+
+			for (size_t frame = 0; frame < count; frame++)
+			{
+				size_t currentSample = job.firstSample + (firstFrame + frame) * sampleInterval;
+				const FFTPlan& framePlan = (firstFrame + frame == numFrames - 1) ? lastPlan : plan;
+				for (SpectrumWriter* w : writers)
+					w->WriteFrame(currentSample, currentSample + sampleInterval, framePlan, spectra[i].data() + frame * stride);
+			}
+
+			if (firstFrame + count == numFrames)
+			{
+				for (SpectrumWriter* w : writers)
+					w->EndChannel();
+			}
+		}
+	};
 
-				toJson(output[chName].back(), spectrum);
+	if (!setts.stats.empty())
+	{
+		std::vector<std::vector<double>> summaries = SummarizeSpectra(setts, job, audio, plan, filename);
+		if (fileRange)
+		{
+			for (const std::vector<double>& summary : summaries)
+			{
+				auto range = std::minmax_element(summary.begin(), summary.end());
+				if (range.first != summary.end())
+				{
+					min = std::min(min, *range.first);
+					max = std::max(max, *range.second);
+				}
+			}
+			if (min <= max)
+				binary->SetRange(min, max);
+		}
 
-				PRINTER(setts, "\rAnalyzing " << filename << "... Channel " << c << "/" << numChannels << " " << (int)std::floor((float)currentSample / (float)audioFile.samples[c-1].size() * 100.0f) << "%                  ");
+		// Every statistic is a frame over the whole range, JSON names them
+		size_t end = job.firstSample + (numFrames - 1) * job.hop + sampleInterval;
+		for (size_t i = 0; i < summaries.size(); i++)
+		{
+			for (SpectrumWriter* w : writers)
+			{
+				w->BeginChannel(job.channels[i]);
+				for (size_t k = 0; k < setts.stats.size(); k++)
+				{
+					if (json && setts.labelStats)
+						json->SetLabel(setts.stats[k].name);
+					w->WriteFrame(job.firstSample, end, plan, summaries[i].data() + k * plan.NumBins());
+				}
+				w->EndChannel();
 			}
 		}
+	}
+	else
+	{
+		if (rangePass)
+			forEachBatch(updateRange);
+		forEachBatch(write);
+	}
+
+	for (SpectrumWriter* w : writers)
+		w->Finish();
+
+	if (compressed)
+		compressed->Close();
+	target.flush();
+
+	PRINTER(setts, "\rAnalyzing " << filename << "... 100%                      " << std::endl);
+}
+
+void AnalyzeStream(const Settings& setts)
+{
+	std::filesystem::path file = setts.files[0];
+	bool isStdin = (file == "-");
+	std::string filename = isStdin ? "stdin" : file.filename().string();
 
-		std::ofstream ofs(file.replace_extension("json"));
-		ofs << std::setw(4) << output.dump() << std::endl;
-		ofs.close();
+	std::ifstream input;
+	if (!isStdin)
+		input.open(file, std::ios::binary);
 
-		PRINTER(setts, "\rAnalyzing " << filename << "... 100%                      " << std::endl);
+	std::istream& in = isStdin ? std::cin : input;
+	AudioStream audio;
+	bool opened = (bool)in;
+	if (!opened || !OpenInput(setts, in, audio))
+	{
+		std::cerr << filename << ": " << (opened ? audio.Error() : "can't open file") << std::endl;
+		return;
 	}
 
-	return 0;
+	int sampleRate = audio.SampleRate();
+	std::vector<unsigned int> selected;
+	std::vector<int> channels;
+	if (setts.analyzeChannel > audio.NumChannels())
+	{
+		std::cerr << filename << " only has " << audio.NumChannels() << " channel(s)" << std::endl;
+		return;
+	}
+	for (unsigned int c = 1; c <= audio.NumChannels(); c++)
+	{
+		if (setts.analyzeChannel == 0 || setts.analyzeChannel == c)
+		{
+			selected.push_back(c - 1);
+			channels.push_back(c);
+		}
+	}
+	audio.SelectChannels(selected);
+
+	if (!setts.bins.empty() && *std::max_element(setts.bins.begin(), setts.bins.end()) > sampleRate / 2.0)
+	{
+		std::cerr << filename << " has a sample rate of " << sampleRate << "Hz, bins above " << sampleRate / 2.0 << "Hz can't be analyzed" << std::endl;
+		return;
+	}
+
+	size_t frameSize = (size_t)(sampleRate * setts.splitInterval / 1000);
+	auto toSample = [&](const Position& position)
+	{
+		return (size_t)(position.samples ? position.value : std::round(position.value * sampleRate));
+	};
+	size_t hop = setts.hasHop ? toSample(setts.hop) : frameSize;
+	if (frameSize == 0 || hop == 0)
+	{
+		std::cerr << "Frames and hops have to be at least one sample long" << std::endl;
+		return;
+	}
+	if (FFTPlan::PaddedSize(frameSize, setts.zeropadding) > std::numeric_limits<unsigned int>::max())
+	{
+		std::cerr << "Frames of " << frameSize << " samples are too long to transform, use a shorter -i" << std::endl;
+		return;
+	}
+
+	size_t firstSample = setts.hasStart ? toSample(setts.start) : 0;
+	size_t endSample = setts.hasEnd ? toSample(setts.end) : AudioStream::UNKNOWN_LENGTH;
+	if (!audio.Seek(firstSample))
+	{
+		std::cerr << filename << ": " << audio.Error() << std::endl;
+		return;
+	}
+
+	FFTPlan plan(frameSize, frameSize, sampleRate, setts.minFreq, setts.maxFreq, setts.zeropadding, setts.bins);
+
+	std::ofstream ofs;
+	if (!isStdin)
+		ofs.open(file.replace_extension(OutputExtension(setts)), std::ios::binary);
+	std::ostream& out = isStdin ? std::cout : static_cast<std::ostream&>(ofs);
+
+	std::unique_ptr<SpectrumWriter> writer;
+	if (setts.format == OutputFormats::BINARY)
+		writer = std::make_unique<BinaryWriter>(out, sampleRate, (unsigned int)channels.size(), setts.scale, setts.quantize, plan.Frequencies());
+	else
+		writer = std::make_unique<JsonWriter>(out, setts.legacy, setts.precisionDigits, plan.Frequencies(), true);
+	writer->Flush();
+
+	// A frame is transformed as soon as its last sample has been read, so only
+	// that many samples are asked for at a time
+	std::vector<SampleRing> rings(channels.size(), SampleRing(frameSize));
+	std::vector<std::vector<double>> spectra(channels.size(), std::vector<double>(plan.NumBins()));
+	std::vector<std::vector<double>> samples;
+
+	// With hops much shorter than a frame, updating the spectrum sample by
+	// sample is cheaper than transforming every frame
+	std::vector<std::unique_ptr<SlidingDFT>> sliding(channels.size());
+	if (SlidingDFT::Faster(plan, hop))
+	{
+		for (auto& dft : sliding)
+			dft = std::make_unique<SlidingDFT>(plan);
+	}
+
+	size_t position = firstSample;
+	size_t frameEnd = firstSample + frameSize;
+
+	LatencyStats latency;
+	auto lastReport = std::chrono::steady_clock::now();
+	auto report = [&](const char* end)
+	{
+		std::cerr << "\r" << latency.Count() << " frames, latency: mean " << latency.Mean() * 1000.0
+			<< "ms, p50 " << latency.Percentile(0.5) * 1000.0 << "ms, p99 " << latency.Percentile(0.99) * 1000.0
+			<< "ms, max " << latency.Max() * 1000.0 << "ms          " << end << std::flush;
+	};
+
+	while (frameEnd <= endSample)
+	{
+		size_t count = std::min(frameEnd - position, STREAM_READ_BLOCK);
+		size_t n = audio.Read(count, samples);
+		if (n == 0)
+			break;
+
+		for (size_t i = 0; i < channels.size(); i++)
+		{
+			if (sliding[i])
+				sliding[i]->Slide(rings[i].Frame(), samples[i].data(), n);
+			rings[i].Push(samples[i].data(), n);
+		}
+		position += n;
+		if (position < frameEnd)
+			continue;
+
+		auto arrival = std::chrono::steady_clock::now();
+
+		auto transform = [&](size_t i)
+		{
+			if (sliding[i])
+				sliding[i]->Execute(rings[i].Frame(), spectra[i].data());
+			else
+				plan.Execute(rings[i].Frame(), frameSize, spectra[i].data());
+		};
+
+		// Handing a single small transform to another thread only adds latency
+		if (channels.size() == 1)
+		{
+			transform(0);
+		}
+		else
+		{
+			TaskGroup transforms(GetThreadPool());
+			for (size_t i = 0; i < channels.size(); i++)
+				transforms.Run([&, i]() { transform(i); });
+			transforms.Wait();
+		}
+
+		for (size_t i = 0; i < channels.size(); i++)
+		{
+			writer->BeginChannel(channels[i]);
+			writer->WriteFrame(frameEnd - frameSize, frameEnd, plan, spectra[i].data());
+			writer->EndChannel();
+		}
+		writer->Flush();
+
+		auto emitted = std::chrono::steady_clock::now();
+		latency.Add(std::chrono::duration<double>(emitted - arrival).count());
+		if (setts.reportLatency && emitted - lastReport > std::chrono::seconds(1))
+		{
+			report("");
+			lastReport = emitted;
+		}
+
+		// With hops longer than a frame, the samples in between are skipped
+		frameEnd += hop;
+	}
+
+	writer->Finish();
+	if (setts.reportLatency)
+		report("\n");
+}
+
+// Parses sizes like 1048576, 1024K or 1M (powers of 1024)
+bool ParseSize(const std::string& text, size_t& size)
+{
+	double value;
+	char unit[4] = "";
+	if (std::sscanf(text.c_str(), "%lf%3s", &value, unit) < 1 || value < 0.0)
+		return false;
+
+	std::string suffix(unit);
+	std::transform(suffix.begin(), suffix.end(), suffix.begin(), [](unsigned char c) { return std::tolower(c); });
+	if (suffix.size() > 1 && (suffix.back() == 'b'))
+		suffix.pop_back();
+	if (suffix.size() > 1 && (suffix.back() == 'i'))
+		suffix.pop_back();
+
+	const std::map<std::string, double> UNITS {
+		{"", 1.0}, {"b", 1.0}, {"k", 1024.0}, {"m", 1024.0 * 1024.0}, {"g", 1024.0 * 1024.0 * 1024.0}
+	};
+	auto it = UNITS.find(suffix);
+	if (it == UNITS.end())
+		return false;
+
+	size = (size_t)(value * it->second);
+	return true;
+}
+
+// Parses positions like 90.5, 1:30.5, 1:01:30, 90500ms or 4410000smp
+bool ParsePosition(const std::string& text, Position& position)
+{
+	std::string number = text;
+	double scale = 1.0;
+	position.samples = false;
+	if (number.size() > 3 && number.compare(number.size() - 3, 3, "smp") == 0)
+	{
+		number.resize(number.size() - 3);
+		position.samples = true;
+	}
+	else if (number.size() > 2 && number.compare(number.size() - 2, 2, "ms") == 0)
+	{
+		number.resize(number.size() - 2);
+		scale = 0.001;
+	}
+	else if (number.size() > 1 && number.back() == 's')
+	{
+		number.pop_back();
+	}
+
+	// Every ':' shifts the seconds parsed so far by a factor of 60
+	position.value = 0.0;
+	size_t begin = 0;
+	while (true)
+	{
+		size_t end = number.find(':', begin);
+		std::string part = number.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+
+		char* rest;
+		double value = std::strtod(part.c_str(), &rest);
+		if (part.empty() || *rest != '\0' || !std::isfinite(value) || value < 0.0 || (position.samples && end != std::string::npos))
+			return false;
+
+		position.value = position.value * 60.0 + value;
+		if (end == std::string::npos)
+			break;
+		begin = end + 1;
+	}
+
+	position.value *= scale;
+	return true;
+}
+
+// Parses min, max, mean or pNN, a percentile between 0 and 100
+bool ParseStat(const std::string& text, Stat& stat)
+{
+	std::string name = text;
+	std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+	stat.name = name;
+	stat.percentile = 0.0;
+	if (name == "min")
+		stat.type = StatTypes::MIN;
+	else if (name == "max")
+		stat.type = StatTypes::MAX;
+	else if (name == "mean")
+		stat.type = StatTypes::MEAN;
+	else if (name.size() > 1 && name[0] == 'p')
+	{
+		char* rest;
+		stat.type = StatTypes::PERCENTILE;
+		stat.percentile = std::strtod(name.c_str() + 1, &rest);
+		if (*rest != '\0' || !(stat.percentile >= 0.0 && stat.percentile <= 100.0))
+			return false;
+	}
+	else
+		return false;
+
+	return true;
 }
 
 Settings Parse(int argc, char** argv)
@@ -153,11 +1145,35 @@ Settings Parse(int argc, char** argv)
 			("q,quiet", "Suppress text output", cxxopts::value<bool>()->default_value("false"))
 			("i,interval", "Splits audio file into intervals of length i milliseconds and transforms them individually (0 to not split file)", cxxopts::value<float>())
 			("f,frequency", "Defines the frequency range of the output spectrum (Default: all the frequencies)", cxxopts::value<std::vector<double>>())
+			("bins", "Only analyze these frequencies, e.g. --bins 50,100,150 (in Hz). Much faster than a full transform for a few dozen frequencies", cxxopts::value<std::vector<double>>())
 			("p,pad", "Add extra zero-padding. By default, the program will pad the signals with 0s until the number of samples is a power of 2 (this would be equivalent to -p 1). With this option you can tell the program to instead pad until the power of 2 after the next one (-p 2) etc. This increases frequency resolution", cxxopts::value<unsigned int>())
 			("w,window", "Specify the window function used (rectangle (default), von-hann, gauss, triangle, blackman (3-term))", cxxopts::value<std::string>()->default_value("rectangle"))
+			("e,engine", "Specify the FFT algorithm used (auto (default), radix2, split-radix, four-step). auto picks a specialized kernel for common frame sizes, four-step for very large transforms and split-radix otherwise", cxxopts::value<std::string>()->default_value("auto"))
+			("s,scale", "Scale of the output values (linear (default), power, db). power and db skip the square root of the magnitude", cxxopts::value<std::string>()->default_value("linear"))
+			("db-floor", "Lowest value of the db scale, quieter bins are clamped to it, from -400 up to below 0 (Default: -120)", cxxopts::value<double>())
+			("format", "Output file format (json (default), ndjson, binary). ndjson writes one line per frame, binary a compact .spec file, see the README for the layouts", cxxopts::value<std::string>()->default_value("json"))
+			("quantize", "Store the values of the binary format as 8 or 16 bit integers instead of doubles. Implies --scale db", cxxopts::value<unsigned int>())
+			("quantize-range", "Range the quantized values are scaled to (file (default), frame). file uses the min/max of the whole file, frame the min/max of every frame", cxxopts::value<std::string>()->default_value("file"))
+			("image", "Also render a spectrogram image next to the output file (png, ppm, pgm). Colors show dB between --db-floor and 0dB", cxxopts::value<std::string>())
+			("image-size", "Size of the image as WIDTHxHEIGHT per channel, 0 keeps one column per frame/one row per frequency, up to 4096x2048 (Default: 0x0)", cxxopts::value<std::string>())
+			("colormap", "Colors of the image (viridis (default), gray). pgm images are always gray", cxxopts::value<std::string>()->default_value("viridis"))
+			("precision-digits", "Number of significant digits of the values in the JSON file (1-15). By default every value is written with as many digits as it takes to read back the exact same number", cxxopts::value<unsigned int>())
+			("z,gzip", "Compress the output file with gzip (.json.gz, .spec.gz)", cxxopts::value<bool>()->default_value("false"))
+			("max-memory", "Upper limit for the memory used for audio data, spectra and buffers, in bytes or with a K, M or G suffix (e.g. 512M). Files that don't fit are read in several passes (Default: no limit)", cxxopts::value<std::string>())
+			("start", "Start of the part of the file that is analyzed, as seconds (90.5), [h:]m:s (1:30.5), milliseconds (90500ms) or samples (4410000smp)", cxxopts::value<std::string>())
+			("end", "End of the part of the file that is analyzed, same format as --start (Default: end of the file)", cxxopts::value<std::string>())
+			("raw", "Read the input as samples without a header, in the given format (u8, s8, s16le, s16be, s24le, s24be, s32le, s32be, f32le, f32be, f64le, f64be). Needs --rate and --channels", cxxopts::value<std::string>())
+			("rate", "Sample rate of --raw input", cxxopts::value<unsigned int>())
+			("channels", "Number of interleaved channels of --raw input", cxxopts::value<unsigned int>())
+			("psd", "Write one averaged power spectrum per channel instead of every frame (welch). Frames overlap by half, see --hop", cxxopts::value<std::string>())
+			("stats", "Write per-bin statistics over all frames per channel instead of every frame, e.g. --stats min,max,mean,p10,p90", cxxopts::value<std::vector<std::string>>())
+			("stream", "Analyze the input while it is being read, e.g. a live recording from stdin, and write every frame as soon as it is done. Needs -i, writes NDJSON instead of JSON")
+			("hop", "Distance between the starts of two frames in --stream, --psd and --stats mode, like --start (Default: the frame length, half of it for --psd)", cxxopts::value<std::string>())
 			("m,mono", "Analyze only the given channel", cxxopts::value<unsigned int>()->default_value("0"))
+			("t,threads", "Number of threads to work with (Default: number of cores)", cxxopts::value<unsigned int>())
+			("decimate", "Low-pass filter and downsample frames before the transform if the maximum frequency (-f) is far below Nyquist. Faster, with the same bins")
 			("approx", "Use faster, but more inaccurate trigonometric functions instead of the std-functions (EXPERIMENTAL)")
-			("files", "Files to fourier transform", cxxopts::value<std::vector<std::filesystem::path>>())
+			("files", "Files to fourier transform, - reads from stdin and writes the result to stdout", cxxopts::value<std::vector<std::filesystem::path>>())
 			("legacy", "Uses the legacy data structure (WHICH IS VERY BAD!)", cxxopts::value<bool>()->default_value("false"))
 			("h,help", "Print usage")
 			;
@@ -182,6 +1198,24 @@ Settings Parse(int argc, char** argv)
 			setts.maxFreq = result["frequency"].as<std::vector<double>>()[1];
 		}
 
+		if (result.count("bins"))
+		{
+			setts.bins = result["bins"].as<std::vector<double>>();
+			if (result.count("frequency"))
+			{
+				std::cerr << "--bins and -f can't be combined" << std::endl;
+				exit(1);
+			}
+			for (double freq : setts.bins)
+			{
+				if (!std::isfinite(freq) || freq < 0.0)
+				{
+					std::cerr << "Invalid bin frequency " << freq << std::endl;
+					exit(1);
+				}
+			}
+		}
+
 		if (!result.count("files"))
 		{
 			std::cerr << "At least one positional argument is required." << std::endl;
@@ -190,11 +1224,87 @@ Settings Parse(int argc, char** argv)
 
 		setts.files = result["files"].as<std::vector<std::filesystem::path>>();
 		setts.quiet = (result.count("quiet") ? result["quiet"].as<bool>() : false);
+
+		size_t stdinCount = std::count(setts.files.begin(), setts.files.end(), std::filesystem::path("-"));
+		if (stdinCount > 1)
+		{
+			std::cerr << "stdin can only be read once" << std::endl;
+			exit(1);
+		}
+
+		// stdout is taken by the results. stderr isn't, so the latency of
+		// --stream is still reported
+		setts.stream = result.count("stream");
+		setts.reportLatency = setts.stream && !setts.quiet;
+		if (stdinCount)
+			setts.quiet = true;
 		setts.splitInterval = (result.count("interval") ? result["interval"].as<float>() : 0.0f);
 		setts.analyzeChannel = (result.count("mono") ? result["mono"].as<unsigned int>() : 0);
 		setts.zeropadding = (result.count("pad") ? result["pad"].as<unsigned int>() : 1);
+		setts.threads = (result.count("threads") ? result["threads"].as<unsigned int>() : std::thread::hardware_concurrency());
+		setts.dbFloor = (result.count("db-floor") ? result["db-floor"].as<double>() : -120.0);
+		if (!std::isfinite(setts.dbFloor) || setts.dbFloor < -400.0 || setts.dbFloor >= 0.0)
+		{
+			std::cerr << "The dB floor has to be at least -400 and below 0" << std::endl;
+			exit(1);
+		}
 		setts.approx = (result.count("approx") ? true : false);
+		setts.decimate = (result.count("decimate") ? true : false);
 		setts.legacy = (result.count("legacy") ? result["legacy"].as<bool>() : false);
+		setts.gzip = (result.count("gzip") ? result["gzip"].as<bool>() : false);
+		setts.precisionDigits = (result.count("precision-digits") ? result["precision-digits"].as<unsigned int>() : 0);
+		if (result.count("precision-digits") && (setts.precisionDigits < 1 || setts.precisionDigits > 15))
+		{
+			std::cerr << "The number of digits has to be between 1 and 15" << std::endl;
+			exit(1);
+		}
+
+		setts.maxMemory = 0;
+		if (result.count("max-memory"))
+		{
+			if (!ParseSize(result["max-memory"].as<std::string>(), setts.maxMemory) || setts.maxMemory == 0)
+			{
+				std::cerr << "Memory limit has to be given as a number of bytes, optionally followed by K, M or G" << std::endl;
+				exit(1);
+			}
+		}
+
+		setts.hasStart = result.count("start");
+		if (setts.hasStart && !ParsePosition(result["start"].as<std::string>(), setts.start))
+		{
+			std::cerr << "Invalid start position" << std::endl;
+			exit(1);
+		}
+
+		setts.hasEnd = result.count("end");
+		if (setts.hasEnd && !ParsePosition(result["end"].as<std::string>(), setts.end))
+		{
+			std::cerr << "Invalid end position" << std::endl;
+			exit(1);
+		}
+
+		setts.raw = result.count("raw");
+		if (setts.raw)
+		{
+			std::string data = result["raw"].as<std::string>();
+			std::transform(data.begin(), data.end(), data.begin(), [](unsigned char c) { return std::tolower(c); });
+			auto it = RAW_FORMATS.find(data);
+			if (it == RAW_FORMATS.end())
+			{
+				std::cerr << "Unknown raw sample format " << data << std::endl;
+				exit(1);
+			}
+			setts.rawFormat = it->second.first;
+			setts.rawBigEndian = it->second.second;
+
+			setts.rawRate = (result.count("rate") ? result["rate"].as<unsigned int>() : 0);
+			setts.rawChannels = (result.count("channels") ? result["channels"].as<unsigned int>() : 0);
+			if (setts.rawRate == 0 || setts.rawChannels == 0)
+			{
+				std::cerr << "Raw input needs --rate and --channels" << std::endl;
+				exit(1);
+			}
+		}
 
 		if (!result.count("window"))
 		{
@@ -215,13 +1325,232 @@ Settings Parse(int argc, char** argv)
 			}
 
 		}
+
+		if (!result.count("engine"))
+		{
+			setts.engine = FFTEngines::AUTO;
+		}
+		else
+		{
+			std::string data = result["engine"].as<std::string>();
+			std::transform(data.begin(), data.end(), data.begin(), [](unsigned char c) { return std::tolower(c); });
+			auto it = ENGINES.find(data);
+			if (it == ENGINES.end())
+			{
+				setts.engine = FFTEngines::AUTO;
+			}
+			else
+			{
+				setts.engine = it->second;
+			}
+		}
 		
 
+		if (!result.count("scale"))
+		{
+			setts.scale = Scales::LINEAR;
+		}
+		else
+		{
+			std::string data = result["scale"].as<std::string>();
+			std::transform(data.begin(), data.end(), data.begin(), [](unsigned char c) { return std::tolower(c); });
+			auto it = SCALES.find(data);
+			if (it == SCALES.end())
+			{
+				setts.scale = Scales::LINEAR;
+			}
+			else
+			{
+				setts.scale = it->second;
+			}
+		}
+
+		if (!result.count("format"))
+		{
+			setts.format = OutputFormats::JSON;
+		}
+		else
+		{
+			std::string data = result["format"].as<std::string>();
+			std::transform(data.begin(), data.end(), data.begin(), [](unsigned char c) { return std::tolower(c); });
+			auto it = FORMATS.find(data);
+			if (it == FORMATS.end())
+			{
+				setts.format = OutputFormats::JSON;
+			}
+			else
+			{
+				setts.format = it->second;
+			}
+		}
+
+		if (!result.count("quantize-range"))
+		{
+			setts.quantizeRange = QuantizeRanges::FILE;
+		}
+		else
+		{
+			std::string data = result["quantize-range"].as<std::string>();
+			std::transform(data.begin(), data.end(), data.begin(), [](unsigned char c) { return std::tolower(c); });
+			auto it = QUANTIZE_RANGES.find(data);
+			if (it == QUANTIZE_RANGES.end())
+			{
+				setts.quantizeRange = QuantizeRanges::FILE;
+			}
+			else
+			{
+				setts.quantizeRange = it->second;
+			}
+		}
+
+		setts.quantize = (result.count("quantize") ? result["quantize"].as<unsigned int>() : 0);
+		if (setts.quantize != 0)
+		{
+			if (setts.quantize != 8 && setts.quantize != 16)
+			{
+				std::cerr << "Values can only be quantized to 8 or 16 bit" << std::endl;
+				exit(1);
+			}
+
+			if (setts.format != OutputFormats::BINARY)
+			{
+				std::cerr << "Quantized values can only be written in the binary format" << std::endl;
+				exit(1);
+			}
+
+			// Quantization is meant for display, where the log scale is what matters
+			setts.scale = Scales::DECIBEL;
+		}
+
+		setts.image = result.count("image");
+		if (setts.image)
+		{
+			std::string data = result["image"].as<std::string>();
+			std::transform(data.begin(), data.end(), data.begin(), [](unsigned char c) { return std::tolower(c); });
+			auto it = IMAGE_FORMATS.find(data);
+			if (it == IMAGE_FORMATS.end())
+			{
+				setts.imageFormat = ImageFormats::PNG;
+			}
+			else
+			{
+				setts.imageFormat = it->second;
+			}
+		}
+
+		if (!result.count("colormap"))
+		{
+			setts.colormap = Colormaps::VIRIDIS;
+		}
+		else
+		{
+			std::string data = result["colormap"].as<std::string>();
+			std::transform(data.begin(), data.end(), data.begin(), [](unsigned char c) { return std::tolower(c); });
+			auto it = COLORMAPS.find(data);
+			if (it == COLORMAPS.end())
+			{
+				setts.colormap = Colormaps::VIRIDIS;
+			}
+			else
+			{
+				setts.colormap = it->second;
+			}
+		}
+
+		if (setts.image && setts.imageFormat == ImageFormats::PGM)
+			setts.colormap = Colormaps::GRAY;
+
+		if (setts.image && stdinCount)
+		{
+			std::cerr << "Images can't be written for stdin, stdout is taken by the results" << std::endl;
+			exit(1);
+		}
+
+		setts.imageWidth = 0;
+		setts.imageHeight = 0;
+		if (result.count("image-size"))
+		{
+			std::string data = result["image-size"].as<std::string>();
+			if (std::sscanf(data.c_str(), "%ux%u", &setts.imageWidth, &setts.imageHeight) != 2)
+			{
+				std::cerr << "Image size has to be given as WIDTHxHEIGHT" << std::endl;
+				exit(1);
+			}
+		}
+
 		if (setts.maxFreq <= setts.minFreq && (setts.maxFreq != 0))
 		{
 			std::cerr << "Maximum frequency cannot be smaller than minimum frequency" << std::endl;
 			exit(1);
 		}
+
+		setts.psd = PSDMethods::NONE;
+		if (result.count("psd"))
+		{
+			std::string data = result["psd"].as<std::string>();
+			std::transform(data.begin(), data.end(), data.begin(), [](unsigned char c) { return std::tolower(c); });
+			auto it = PSD_METHODS.find(data);
+			if (it == PSD_METHODS.end())
+			{
+				setts.psd = PSDMethods::WELCH;
+			}
+			else
+			{
+				setts.psd = it->second;
+			}
+
+		}
+
+		setts.stats.clear();
+		if (result.count("stats"))
+		{
+			for (const std::string& name : result["stats"].as<std::vector<std::string>>())
+			{
+				Stat stat;
+				if (!ParseStat(name, stat))
+				{
+					std::cerr << "Unknown statistic " << name << ", use min, max, mean or pNN" << std::endl;
+					exit(1);
+				}
+				setts.stats.push_back(stat);
+			}
+		}
+
+		// Welch's method is the mean, written without a name unless --stats is given too
+		setts.labelStats = !setts.stats.empty();
+		if (setts.psd != PSDMethods::NONE && std::none_of(setts.stats.begin(), setts.stats.end(), [](const Stat& stat) { return stat.type == StatTypes::MEAN; }))
+			setts.stats.insert(setts.stats.begin(), { StatTypes::MEAN, 0.0, "mean" });
+
+		if (!setts.stats.empty() && (setts.stream || setts.image))
+		{
+			std::cerr << "--psd and --stats can't be combined with --stream or --image" << std::endl;
+			exit(1);
+		}
+
+		setts.hasHop = result.count("hop");
+		if (setts.hasHop && !ParsePosition(result["hop"].as<std::string>(), setts.hop))
+		{
+			std::cerr << "Invalid hop" << std::endl;
+			exit(1);
+		}
+		if (setts.stream)
+		{
+			if (setts.files.size() != 1 || setts.splitInterval <= 0.0f)
+			{
+				std::cerr << "--stream analyzes exactly one input and needs a frame length (-i)" << std::endl;
+				exit(1);
+			}
+			if (setts.gzip || setts.image)
+			{
+				std::cerr << "--stream can't be combined with -z or --image, both only finish at the end of the input" << std::endl;
+				exit(1);
+			}
+
+			// Frames can't wait for the rest of the input
+			if (setts.format == OutputFormats::JSON)
+				setts.format = OutputFormats::NDJSON;
+			setts.quantizeRange = QuantizeRanges::FRAME;
+		}
 	}
 	catch (const cxxopts::OptionException& e)
 	{